@@ -15,6 +15,13 @@ virtual double deriv(double arg, double value) = 0;
 
 virtual std::string getName() = 0;
 
+/**
+ * whether use gives the same value as act, so that outputs computed
+ * in training can stand in for outputs computed in use
+ */
+
+virtual bool useMatchesAct() { return true; }
+
 virtual ~ActivationFunction() {}
 
 };
@@ -0,0 +1,100 @@
+// file:    Adam.cc
+// purpose: C++ code for Adam class
+
+#include "Adam.h"
+#include <math.h>
+
+
+/**
+ * constructor
+ */
+
+Adam::Adam(double _beta1, double _beta2, double _epsilon)
+  {
+  beta1 = _beta1;
+  beta2 = _beta2;
+  epsilon = _epsilon;
+  steps = 0;
+  }
+
+
+/**
+ * Adam keeps two moments per weight.
+ */
+
+int Adam::getStateSize() const
+  {
+  return 2;		// first and second moments
+  }
+
+
+/**
+ * Count the step, for the bias correction.
+ */
+
+void Adam::beginStep()
+  {
+  steps++;
+  }
+
+
+/**
+ * Update n weights against the gradient, scaled by scale, keeping the first
+ * moments and then the second moments in the state.
+ */
+
+void Adam::adjust(int n, double* __restrict weight, const double* __restrict gradient,
+                  double* __restrict state, double rate, double scale) const
+  {
+  double* __restrict first = state;
+  double* __restrict second = state + n;
+
+  // Fold the bias corrections into the rate and epsilon.
+
+  double correction1 = 1 - pow(beta1, steps);
+  double correction2 = sqrt(1 - pow(beta2, steps));
+  double stepRate = rate*correction2/correction1;
+  double stepEpsilon = epsilon*correction2;
+
+  for( int j = 0; j < n; j++ )
+    {
+    double g = scale*gradient[j];
+    double m = beta1*first[j] + (1-beta1)*g;
+    double v = beta2*second[j] + (1-beta2)*g*g;
+
+    first[j] = m;
+    second[j] = v;
+    weight[j] -= stepRate*m/(sqrt(v) + stepEpsilon);
+    }
+  }
+
+
+/**
+ * Save or restore the number of steps taken.
+ */
+
+void Adam::saveState(Checkpoint& checkpoint) const
+  {
+  checkpoint.putInt(steps);
+  }
+
+void Adam::loadState(Checkpoint& checkpoint)
+  {
+  steps = checkpoint.getInt();
+  }
+
+
+std::string Adam::getName() const
+  {
+  return "adam";
+  }
+
+
+/**
+ * Make a fresh copy with the same settings, and no steps taken.
+ */
+
+Optimizer* Adam::clone() const
+  {
+  return new Adam(beta1, beta2, epsilon);
+  }
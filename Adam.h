@@ -0,0 +1,90 @@
+// file:    Adam.h
+// purpose: Header file for Adam class
+
+#ifndef __Adam__
+#define __Adam__
+
+#include "Optimizer.h"
+
+/**
+ * Adam: steps are the bias-corrected first moment of the gradient divided by
+ * the square root of its bias-corrected second moment.
+ */
+
+class Adam : public Optimizer
+{
+private:
+
+/**
+ * the decay rates of the first and second moments
+ */
+
+double beta1;
+
+double beta2;
+
+/**
+ * added to the root of the second moment, so that no step divides by 0
+ */
+
+double epsilon;
+
+/**
+ * the number of steps taken, for the bias correction
+ */
+
+int steps;
+
+public:
+
+/**
+ * constructor
+ */
+
+Adam(double _beta1, double _beta2, double _epsilon);
+
+
+/**
+ * Adam keeps two moments per weight.
+ */
+
+int getStateSize() const;
+
+
+/**
+ * Count the step, for the bias correction.
+ */
+
+void beginStep();
+
+
+/**
+ * Update n weights against the gradient, scaled by scale, keeping the first
+ * moments and then the second moments in the state.
+ */
+
+void adjust(int n, double* weight, const double* gradient, double* state,
+            double rate, double scale) const;
+
+
+std::string getName() const;
+
+
+/**
+ * Save or restore the number of steps taken.
+ */
+
+void saveState(Checkpoint& checkpoint) const;
+
+void loadState(Checkpoint& checkpoint);
+
+
+/**
+ * Make a fresh copy with the same settings, and no steps taken.
+ */
+
+Optimizer* clone() const;
+
+}; // class Adam
+
+#endif
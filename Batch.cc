@@ -0,0 +1,136 @@
+// file:    Batch.cc
+// purpose: C++ code for Batch class
+
+#include "Batch.h"
+#include "Network.h"
+
+#include <assert.h>
+
+
+/**
+ * Create a batch able to hold up to capacity samples for the given Network.
+ */
+
+Batch::Batch(const Network& network, int _capacity)
+  {
+  assert( _capacity > 0 );
+
+  capacity = _capacity;
+
+  size = 0;
+
+  inputDimension = network.getInputDimension();
+
+  numberLayers = network.getNumberLayers();
+
+  assert( sample = new const Sample*[capacity] );
+
+  assert( input = new double[capacity*inputDimension] );
+
+  assert( output = new double*[numberLayers] );
+  assert( deriv = new double*[numberLayers] );
+  assert( sensitivity = new double*[numberLayers] );
+
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    int n = capacity*network.getLayer(i).getSize();
+
+    assert( output[i] = new double[n] );
+    assert( deriv[i] = new double[n] );
+    assert( sensitivity[i] = new double[n] );
+    }
+  }
+
+
+/**
+ * Load samples into the batch, copying their inputs into the input matrix.
+ */
+
+void Batch::load(Sample* const* samples, int n)
+  {
+  assert( n <= capacity );
+
+  size = n;
+
+  for( int b = 0; b < size; b++ )
+    {
+    sample[b] = samples[b];
+
+    double* row = input + b*inputDimension;
+
+    for( int j = 0; j < inputDimension; j++ )
+      {
+      row[j] = samples[b]->getInput(j);
+      }
+    }
+  }
+
+
+int Batch::getSize() const
+  {
+  return size;
+  }
+
+
+int Batch::getCapacity() const
+  {
+  return capacity;
+  }
+
+
+const Sample& Batch::getSample(int b) const
+  {
+  assert( b < size );
+  return *(sample[b]);
+  }
+
+
+const Sample* const* Batch::getSamples() const
+  {
+  return sample;
+  }
+
+
+double* Batch::getInput() const
+  {
+  return input;
+  }
+
+
+double* Batch::getOutput(int layer) const
+  {
+  return output[layer];
+  }
+
+
+double* Batch::getDeriv(int layer) const
+  {
+  return deriv[layer];
+  }
+
+
+double* Batch::getSensitivity(int layer) const
+  {
+  return sensitivity[layer];
+  }
+
+
+/**
+ * destructor
+ */
+
+Batch::~Batch()
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    delete [] output[i];
+    delete [] deriv[i];
+    delete [] sensitivity[i];
+    }
+
+  delete [] output;
+  delete [] deriv;
+  delete [] sensitivity;
+  delete [] input;
+  delete [] sample;
+  }
@@ -0,0 +1,116 @@
+// file:    Batch.h
+// purpose: Header file for Batch class
+
+#ifndef __Batch__
+#define __Batch__
+
+#include "Sample.h"
+
+class Network;
+
+/**
+ * A Batch holds a group of Samples together with the matrices needed to
+ * propagate them through a Network at once: the inputs, and for every Layer
+ * the outputs, activation function derivatives and sensitivities.
+ *
+ * Each matrix has one row per sample, so a Layer can fire or backpropagate
+ * the whole batch with matrix products rather than one Neuron at a time.
+ * The Batch does not own its Samples.
+ */
+
+class Batch
+{
+private:
+
+/**
+ * the maximum number of samples in the batch
+ */
+
+int capacity;
+
+/**
+ * the number of samples currently loaded
+ */
+
+int size;
+
+int inputDimension;
+
+int numberLayers;
+
+/**
+ * the loaded samples
+ */
+
+const Sample** sample;
+
+/**
+ * size x inputDimension matrix of sample inputs
+ */
+
+double* input;
+
+/**
+ * per layer, size x layer size matrices
+ */
+
+double** output;
+
+double** deriv;
+
+double** sensitivity;
+
+public:
+
+/**
+ * Create a batch able to hold up to capacity samples for the given Network.
+ */
+
+Batch(const Network& network, int _capacity);
+
+
+/**
+ * Load samples into the batch, copying their inputs into the input matrix.
+ */
+
+void load(Sample* const* samples, int n);
+
+
+/**
+ * Get the number of samples currently loaded.
+ */
+
+int getSize() const;
+
+
+int getCapacity() const;
+
+
+/**
+ * Get the bth loaded sample.
+ */
+
+const Sample& getSample(int b) const;
+
+
+const Sample* const* getSamples() const;
+
+
+double* getInput() const;
+
+double* getOutput(int layer) const;
+
+double* getDeriv(int layer) const;
+
+double* getSensitivity(int layer) const;
+
+
+/**
+ * destructor
+ */
+
+~Batch();
+
+}; // class Batch
+
+#endif
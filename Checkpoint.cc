@@ -0,0 +1,243 @@
+// file:    Checkpoint.cc
+// purpose: C++ code for Checkpoint class
+
+#include "Checkpoint.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * constructor, for an empty buffer
+ */
+
+Checkpoint::Checkpoint()
+  {
+  position = 0;
+  writing = false;
+  writeSucceeded = true;
+  }
+
+
+/**
+ * Empty the buffer, to fill it afresh.
+ */
+
+void Checkpoint::clear()
+  {
+  data.clear();
+  position = 0;
+  }
+
+
+void Checkpoint::append(const void* values, size_t size)
+  {
+  const char* bytes = (const char*)values;
+  data.insert(data.end(), bytes, bytes + size);
+  }
+
+
+void Checkpoint::extract(void* values, size_t size)
+  {
+  if( position + size > data.size() )
+    {
+    printf("error, checkpoint is truncated\n");
+    exit(1);
+    }
+
+  memcpy(values, &data[position], size);
+  position += size;
+  }
+
+
+void Checkpoint::putInt(int value)
+  {
+  append(&value, sizeof(value));
+  }
+
+void Checkpoint::putDouble(double value)
+  {
+  append(&value, sizeof(value));
+  }
+
+void Checkpoint::putDoubles(const double* values, int n)
+  {
+  append(values, n*sizeof(double));
+  }
+
+void Checkpoint::putLongs(const uint64_t* values, int n)
+  {
+  append(values, n*sizeof(uint64_t));
+  }
+
+
+int Checkpoint::getInt()
+  {
+  int value;
+  extract(&value, sizeof(value));
+  return value;
+  }
+
+double Checkpoint::getDouble()
+  {
+  double value;
+  extract(&value, sizeof(value));
+  return value;
+  }
+
+void Checkpoint::getDoubles(double* values, int n)
+  {
+  extract(values, n*sizeof(double));
+  }
+
+void Checkpoint::getLongs(uint64_t* values, int n)
+  {
+  extract(values, n*sizeof(uint64_t));
+  }
+
+
+/**
+ * Read a whole file into the buffer, returning false if it cannot be read.
+ */
+
+bool Checkpoint::read(const char* path)
+  {
+  FILE* file = fopen(path, "rb");
+
+  if( file == NULL )
+    {
+    return false;
+    }
+
+  clear();
+
+  char block[65536];
+  size_t count;
+
+  while( (count = fread(block, 1, sizeof(block), file)) > 0 )
+    {
+    append(block, count);
+    }
+
+  bool ok = !ferror(file);
+
+  fclose(file);
+
+  return ok;
+  }
+
+
+/**
+ * Write the buffer to a file atomically, returning false on failure.
+ *
+ * The data goes to path.tmp, is flushed to the disk, and then replaces
+ * the file by a rename, which is flushed with the directory.
+ */
+
+bool Checkpoint::write(const char* path)
+  {
+  std::string temporary = std::string(path) + ".tmp";
+
+  FILE* file = fopen(temporary.c_str(), "wb");
+
+  if( file == NULL )
+    {
+    return false;
+    }
+
+  bool ok = data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size();
+
+  ok = (fflush(file) == 0) && ok;
+  ok = (fsync(fileno(file)) == 0) && ok;
+  ok = (fclose(file) == 0) && ok;
+
+  if( !ok )
+    {
+    remove(temporary.c_str());
+    return false;
+    }
+
+  if( rename(temporary.c_str(), path) != 0 )
+    {
+    return false;
+    }
+
+  // The rename is only durable once the directory holding it is synced.
+
+  std::string directory = path;
+  size_t slash = directory.rfind('/');
+
+  directory = slash == std::string::npos ? "." : slash == 0 ? "/" : directory.substr(0, slash);
+
+  int descriptor = open(directory.c_str(), O_RDONLY);
+
+  if( descriptor < 0 )
+    {
+    return false;
+    }
+
+  ok = fsync(descriptor) == 0;
+  ok = (close(descriptor) == 0) && ok;
+
+  return ok;
+  }
+
+
+void* Checkpoint::runWrite(void* checkpoint)
+  {
+  Checkpoint* self = (Checkpoint*)checkpoint;
+
+  self->writeSucceeded = self->write(self->writePath.c_str());
+
+  return NULL;
+  }
+
+
+/**
+ * Start writing the buffer to a file in a background thread.
+ */
+
+void Checkpoint::startWrite(const char* path)
+  {
+  finishWrite();
+
+  writePath = path;
+
+  if( pthread_create(&writer, NULL, runWrite, this) == 0 )
+    {
+    writing = true;
+    }
+  else
+    {
+    writeSucceeded = write(path);	// no thread; write it now
+    }
+  }
+
+
+/**
+ * Wait for a background write, if any, returning false if it failed.
+ */
+
+bool Checkpoint::finishWrite()
+  {
+  if( writing )
+    {
+    pthread_join(writer, NULL);
+    writing = false;
+    }
+
+  return writeSucceeded;
+  }
+
+
+/**
+ * destructor, which waits for a background write
+ */
+
+Checkpoint::~Checkpoint()
+  {
+  finishWrite();
+  }
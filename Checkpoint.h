@@ -0,0 +1,128 @@
+// file:    Checkpoint.h
+// purpose: Header file for Checkpoint class
+
+#ifndef __Checkpoint__
+#define __Checkpoint__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * A Checkpoint is a buffer of binary values (ints, doubles and 64-bit words, in
+ * the machine's own representation) holding a training state, which can be
+ * written to or read from a file.
+ *
+ * Files are written atomically: to a temporary file that is then renamed,
+ * so a crash leaves either the old checkpoint or the new one.  A write can
+ * run in a background thread, while training continues; the buffer must
+ * not be changed until finishWrite has returned.
+ */
+
+class Checkpoint
+{
+private:
+
+std::vector<char> data;
+
+/**
+ * where the next value is read from
+ */
+
+size_t position;
+
+/**
+ * the background writer, if one is running, and the file it writes
+ */
+
+pthread_t writer;
+
+bool writing;
+
+std::string writePath;
+
+bool writeSucceeded;
+
+static void* runWrite(void* checkpoint);
+
+void append(const void* values, size_t size);
+
+void extract(void* values, size_t size);
+
+public:
+
+/**
+ * constructor, for an empty buffer
+ */
+
+Checkpoint();
+
+
+/**
+ * Empty the buffer, to fill it afresh.
+ */
+
+void clear();
+
+
+void putInt(int value);
+
+void putDouble(double value);
+
+void putDoubles(const double* values, int n);
+
+void putLongs(const uint64_t* values, int n);
+
+
+/**
+ * Get values in the order they were put.  Reading past the end of the
+ * data is a fatal error.
+ */
+
+int getInt();
+
+double getDouble();
+
+void getDoubles(double* values, int n);
+
+void getLongs(uint64_t* values, int n);
+
+
+/**
+ * Read a whole file into the buffer, returning false if it cannot be read.
+ */
+
+bool read(const char* path);
+
+
+/**
+ * Write the buffer to a file atomically, returning false on failure.
+ */
+
+bool write(const char* path);
+
+
+/**
+ * Start writing the buffer to a file in a background thread.
+ */
+
+void startWrite(const char* path);
+
+
+/**
+ * Wait for a background write, if any, returning false if it failed.
+ */
+
+bool finishWrite();
+
+
+/**
+ * destructor, which waits for a background write
+ */
+
+~Checkpoint();
+
+}; // class Checkpoint
+
+#endif
@@ -0,0 +1,389 @@
+// file:    ConvLayer.cc
+// purpose: C++ code for ConvLayer class
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ConvLayer.h"
+
+
+/**
+ * constructor
+ */
+
+ConvLayer::ConvLayer(int _layerIndex, int _numberOfFilters, Convolution* _convolution,
+                     int _inputDimension, Random& random) : Layer()
+  {
+  init(_layerIndex, _numberOfFilters, _convolution, _inputDimension, random);
+  }
+
+
+/**
+ * Initialize the layer by specifying the number of filters, the shape of
+ * the convolution and the number of inputs.
+ *
+ * The Layer keeps the filters as its Neurons, each with a window of inputs.
+ */
+
+void ConvLayer::init(int _layerIndex, int _numberOfFilters, Convolution* _convolution,
+                     int _inputDimension, Random& random)
+  {
+  convolution = _convolution;
+
+  inputDimension = _inputDimension;
+
+  assert( convolution->fits(inputDimension) );
+
+  lead = convolution->getLead();
+  width = convolution->getWidth();
+  kernel = convolution->getKernel();
+  stride = convolution->getStride();
+  pool = convolution->getPool();
+
+  positions = convolution->getPositions(inputDimension);
+  groups = convolution->getGroups(inputDimension);
+
+  Layer::init(_layerIndex, _numberOfFilters, convolution->getFunction(),
+              convolution->getWindow(), random);
+
+  numberOfOutputs = groups*numberInLayer;
+
+  // The weighted sensitivities from the next layer are one per output.
+
+  delete [] weightedSensitivity;
+
+  assert( weightedSensitivity = new double[numberOfOutputs] );
+
+  assert( input = new double[inputDimension] );
+  assert( output = new double[numberOfOutputs] );
+  assert( deriv = new double[numberOfOutputs] );
+  assert( sensitivity = new double[numberOfOutputs] );
+  assert( winner = new int[numberOfOutputs] );
+
+  for( int o = 0; o < numberOfOutputs; o++ )
+    {
+    output[o] = deriv[o] = sensitivity[o] = 0;
+    winner[o] = 0;
+    }
+  }
+
+
+/**
+ * Return the number of outputs: the filters times the pools of positions.
+ */
+
+int ConvLayer::getSize() const
+  {
+  return numberOfOutputs;
+  }
+
+
+std::string ConvLayer::getType() const
+  {
+  return convolution->getName();
+  }
+
+
+/**
+ * Get the value of the ith output.
+ */
+
+double ConvLayer::get(int i) const
+  {
+  return output[i];
+  }
+
+
+/**
+ * Return the part of a filter's net from the lead inputs and the bias.
+ */
+
+double ConvLayer::getLeadNet(const double* row, const double* in) const
+  {
+  double net = row[numberOfInputs];	// bias
+
+  for( int j = 0; j < lead; j++ )
+    {
+    net += row[j]*in[j];
+    }
+
+  return net;
+  }
+
+
+/**
+ * Find the position of the largest net of a filter in the gth pool of a row
+ * of inputs, setting the net.  The window of position t starts t*stride
+ * slots after the lead inputs, and its weights follow those of the lead.
+ */
+
+int ConvLayer::findWinner(const double* row, double leadNet, const double* in, int g,
+                          double& net) const
+  {
+  const double* slotRow = row + lead;
+  int slotInputs = kernel*width;
+
+  int first = g*pool;
+  int last = first + pool < positions ? first + pool : positions;
+
+  int best = first;
+
+  for( int t = first; t < last; t++ )
+    {
+    const double* window = in + lead + t*stride*width;
+
+    double sum = leadNet;
+
+    for( int j = 0; j < slotInputs; j++ )
+      {
+      sum += slotRow[j]*window[j];
+      }
+
+    if( t == first || sum > net )
+      {
+      net = sum;
+      best = t;
+      }
+    }
+
+  return best;
+  }
+
+
+/**
+ * Fire the filters on a row of inputs, setting the outputs, and the
+ * derivatives and winning positions unless NULL.
+ */
+
+void ConvLayer::convolve(const double* in, bool inUse, double* out, double* der, int* win) const
+  {
+  int rowSize = numberOfInputs+1;
+
+  for( int c = 0; c < numberInLayer; c++ )
+    {
+    const double* row = weight + c*rowSize;
+
+    double leadNet = getLeadNet(row, in);
+
+    for( int g = 0; g < groups; g++ )
+      {
+      int o = g*numberInLayer + c;
+
+      double net;
+
+      int t = findWinner(row, leadNet, in, g, net);
+
+      out[o] = inUse ? type->use(net) : type->act(net);
+
+      if( der )
+        {
+        der[o] = type->deriv(net, out[o]);
+        }
+
+      if( win )
+        {
+        win[o] = t;
+        }
+      }
+    }
+  }
+
+
+/**
+ * Fire the layer on a Sample, keeping its inputs for backpropagation.
+ */
+
+void ConvLayer::fire(const Source& source)
+  {
+  for( int j = 0; j < inputDimension; j++ )
+    {
+    input[j] = source.get(j);
+    }
+
+  convolve(input, false, output, deriv, winner);
+  }
+
+
+void ConvLayer::use(const Source& source)
+  {
+  for( int j = 0; j < inputDimension; j++ )
+    {
+    input[j] = source.get(j);
+    }
+
+  convolve(input, true, output, NULL, NULL);
+  }
+
+
+/**
+ * Set the sensitivities of the outputs, based on the next Layer.
+ */
+
+void ConvLayer::setSensitivity(const Layer& nextLayer)
+  {
+  assert( nextLayer.getNumberOfInputs() == numberOfOutputs );
+
+  nextLayer.getSumsWeightedSensitivity(weightedSensitivity);
+
+  for( int o = 0; o < numberOfOutputs; o++ )
+    {
+    sensitivity[o] = deriv[o]*weightedSensitivity[o];
+    }
+  }
+
+
+void ConvLayer::scaleSensitivity(double factor)
+  {
+  for( int o = 0; o < numberOfOutputs; o++ )
+    {
+    sensitivity[o] *= factor;
+    }
+  }
+
+
+/**
+ * Add the gradient of a filter from its window at a position, times a
+ * factor, to a row shaped like its weights.
+ */
+
+void ConvLayer::addWindow(double* row, const double* in, int position, double factor) const
+  {
+  for( int j = 0; j < lead; j++ )
+    {
+    row[j] += factor*in[j];
+    }
+
+  double* slotRow = row + lead;
+  const double* window = in + lead + position*stride*width;
+  int slotInputs = kernel*width;
+
+  for( int j = 0; j < slotInputs; j++ )
+    {
+    slotRow[j] += factor*window[j];
+    }
+
+  row[numberOfInputs] += factor;	// bias
+  }
+
+
+/**
+ * Add the gradient of the Sample last fired, times a factor, to an array
+ * shaped like the weights.
+ */
+
+void ConvLayer::addGradient(double* gradient, double factor) const
+  {
+  int rowSize = numberOfInputs+1;
+
+  for( int o = 0; o < numberOfOutputs; o++ )
+    {
+    if( sensitivity[o] != 0 )
+      {
+      int c = o % numberInLayer;
+
+      addWindow(gradient + c*rowSize, input, winner[o], factor*sensitivity[o]);
+      }
+    }
+  }
+
+
+/**
+ * The weights change as the Neurons' would, from the inputs kept when the
+ * layer fired on the Source.
+ */
+
+void ConvLayer::adjustWeights(const Source& source, double rate)
+  {
+  addGradient(weight, -rate);
+  }
+
+
+void ConvLayer::accumulateWeights(const Source& source, double rate)
+  {
+  addGradient(accumulated, -rate);
+  }
+
+
+void ConvLayer::accumulateGradient(const Source& source)
+  {
+  addGradient(accumulated, 1);
+  }
+
+
+void ConvLayer::getGradientRow(const Source& source, double* row) const
+  {
+  int n = getParameterCount();
+
+  for( int k = 0; k < n; k++ )
+    {
+    row[k] = 0;
+    }
+
+  addGradient(row, 1);
+  }
+
+
+/**
+ * Fire the layer on a batch of inputs, a row of them per sample.
+ */
+
+void ConvLayer::fireBatch(const double* input, int batchSize, double* output, double* deriv) const
+  {
+  for( int b = 0; b < batchSize; b++ )
+    {
+    convolve(input + b*inputDimension, false,
+             output + b*numberOfOutputs, deriv + b*numberOfOutputs, NULL);
+    }
+  }
+
+
+/**
+ * Add the gradient over a Batch into an array shaped like the weights,
+ * finding the winning positions again.
+ */
+
+void ConvLayer::addGradientBatch(const double* input, const double* sensitivity, int batchSize,
+                                 double* gradient) const
+  {
+  int rowSize = numberOfInputs+1;
+
+  for( int b = 0; b < batchSize; b++ )
+    {
+    const double* in = input + b*inputDimension;
+    const double* sensitivityRow = sensitivity + b*numberOfOutputs;
+
+    for( int c = 0; c < numberInLayer; c++ )
+      {
+      const double* row = weight + c*rowSize;
+
+      double leadNet = pool > 1 ? getLeadNet(row, in) : 0;	// only to find winners
+
+      for( int g = 0; g < groups; g++ )
+        {
+        double s = sensitivityRow[g*numberInLayer + c];
+
+        if( s == 0 )
+          {
+          continue;
+          }
+
+        double net;
+
+        int t = pool > 1 ? findWinner(row, leadNet, in, g, net) : g;
+
+        addWindow(gradient + c*rowSize, in, t, s);
+        }
+      }
+    }
+  }
+
+
+ConvLayer::~ConvLayer()
+  {
+  delete [] input;
+  delete [] output;
+  delete [] deriv;
+  delete [] sensitivity;
+  delete [] winner;
+  }
@@ -0,0 +1,203 @@
+// file:    ConvLayer.h
+// purpose: Header file for ConvLayer class
+
+#ifndef __ConvLayer__
+#define __ConvLayer__
+
+#include "Convolution.h"
+#include "Layer.h"
+
+/**
+ * A ConvLayer is a first layer whose Neurons are filters, shared by its
+ * outputs: each filter is applied to a window of the inputs at every
+ * position along the slots that its Convolution describes, and the largest
+ * of each pool of positions is an output.  The outputs are laid out by pool,
+ * and within a pool by filter.
+ *
+ * Each filter's window is the lead inputs followed by kernel slots, so its
+ * row of weights is laid out the same way, with the bias last.  The part of
+ * the net from the lead inputs is the same at every position, and is found
+ * once per filter.  The activation functions are all nondecreasing, so the
+ * largest net of a pool gives its largest output, and only that net is
+ * activated.  A pooled output backpropagates through the position that won.
+ *
+ * The weights are those of the filters, and the Layer keeps them, and their
+ * training state, in its arrays as it does for its Neurons, with the filters
+ * as its Neurons.  Only the firing and the gradient differ.
+ */
+
+class ConvLayer : public Layer
+{
+private:
+
+Convolution* convolution;
+
+/**
+ * the number of inputs to the layer, and the shape of the convolution
+ */
+
+int inputDimension;
+
+int lead;
+
+int width;
+
+int kernel;
+
+int stride;
+
+int pool;
+
+/**
+ * the number of positions of the filters, and of outputs of each filter
+ */
+
+int positions;
+
+int groups;
+
+int numberOfOutputs;
+
+/**
+ * for the Sample last fired: its inputs, and for each output, its value,
+ * derivative, sensitivity and the position that won its pool
+ */
+
+double* input;
+
+double* output;
+
+double* deriv;
+
+double* sensitivity;
+
+int* winner;
+
+
+/**
+ * Return the part of a filter's net from the lead inputs and the bias.
+ */
+
+double getLeadNet(const double* row, const double* in) const;
+
+
+/**
+ * Find the position of the largest net of a filter, given its row of
+ * weights and lead net, in the gth pool of a row of inputs, setting the net.
+ */
+
+int findWinner(const double* row, double leadNet, const double* in, int g, double& net) const;
+
+
+/**
+ * Fire the filters on a row of inputs, setting the outputs, and the
+ * derivatives and winning positions unless NULL.
+ */
+
+void convolve(const double* in, bool inUse, double* out, double* der, int* win) const;
+
+
+/**
+ * Add the gradient of a filter from its window at a position, times a
+ * factor, to a row shaped like its weights.
+ */
+
+void addWindow(double* row, const double* in, int position, double factor) const;
+
+
+/**
+ * Add the gradient of the Sample last fired, times a factor, to an array
+ * shaped like the weights.
+ */
+
+void addGradient(double* gradient, double factor) const;
+
+
+public:
+
+/**
+ * constructor
+ */
+
+ConvLayer(int _layerIndex, int _numberOfFilters, Convolution* _convolution, int _inputDimension,
+          Random& random);
+
+
+/**
+ * Initialize the layer by specifying the number of filters, the shape of
+ * the convolution and the number of inputs.
+ *
+ * Randomize the weights of each filter.
+ */
+
+void init(int _layerIndex, int _numberOfFilters, Convolution* _convolution, int _inputDimension,
+          Random& random);
+
+
+/**
+ * Return the number of outputs: the filters times the pools of positions.
+ */
+
+int getSize() const;
+
+
+/**
+ * The layer is saved and reloaded by the name of its Convolution, which
+ * gives its shape, rather than by that of its activation function.
+ */
+
+std::string getType() const;
+
+
+double get(int i) const;
+
+void fire(const Source& source);
+
+void use(const Source& source);
+
+
+/**
+ * Set the sensitivities of the outputs, based on the next Layer.
+ */
+
+void setSensitivity(const Layer& nextLayer);
+
+void scaleSensitivity(double factor);
+
+
+/**
+ * The weight changes and gradients are those of the filters, summed over
+ * the outputs that share them.  Outputs whose sensitivity is 0 are skipped.
+ */
+
+void adjustWeights(const Source& source, double rate);
+
+void accumulateWeights(const Source& source, double rate);
+
+void accumulateGradient(const Source& source);
+
+void getGradientRow(const Source& source, double* row) const;
+
+
+void fireBatch(const double* input, int batchSize, double* output, double* deriv) const;
+
+
+/**
+ * Add the gradient over a Batch into an array shaped like the weights.  The
+ * winning positions are found again, since the Layer is shared by the
+ * threads computing gradients and keeps nothing of a Batch.
+ */
+
+void addGradientBatch(const double* input, const double* sensitivity, int batchSize,
+                      double* gradient) const;
+
+
+/**
+ * Destructor
+ */
+
+virtual ~ConvLayer();
+
+}; // class ConvLayer
+
+#endif
@@ -0,0 +1,138 @@
+// file:    Convolution.cc
+// purpose: C++ code for Convolution class
+
+#include "Convolution.h"
+
+#include <stdio.h>
+
+
+/**
+ * constructor
+ */
+
+Convolution::Convolution(ActivationFunction* _function, int _width, int _kernel, int _stride,
+                         int _pool, int _lead)
+  {
+  function = _function;
+  width = _width;
+  kernel = _kernel;
+  stride = _stride;
+  pool = _pool;
+  lead = _lead;
+  }
+
+
+double Convolution::act(double arg)
+  {
+  return function->act(arg);
+  }
+
+double Convolution::use(double arg)
+  {
+  return function->use(arg);
+  }
+
+double Convolution::deriv(double arg, double out)
+  {
+  return function->deriv(arg, out);
+  }
+
+bool Convolution::useMatchesAct()
+  {
+  return function->useMatchesAct();
+  }
+
+
+std::string Convolution::getName()
+  {
+  char shape[64];
+
+  snprintf(shape, sizeof(shape), ":%d:%d:%d:%d:%d", width, kernel, stride, pool, lead);
+
+  return "conv:" + function->getName() + shape;
+  }
+
+
+ActivationFunction* Convolution::getFunction() const
+  {
+  return function;
+  }
+
+int Convolution::getWidth() const
+  {
+  return width;
+  }
+
+int Convolution::getKernel() const
+  {
+  return kernel;
+  }
+
+int Convolution::getStride() const
+  {
+  return stride;
+  }
+
+int Convolution::getPool() const
+  {
+  return pool;
+  }
+
+int Convolution::getLead() const
+  {
+  return lead;
+  }
+
+
+/**
+ * Return the number of inputs each filter looks at, not including its bias.
+ */
+
+int Convolution::getWindow() const
+  {
+  return lead + kernel*width;
+  }
+
+
+/**
+ * Return whether the convolution fits a number of inputs.
+ */
+
+bool Convolution::fits(int inputDimension) const
+  {
+  int slotInputs = inputDimension - lead;
+
+  return slotInputs >= kernel*width && slotInputs % width == 0;
+  }
+
+
+/**
+ * Return the number of positions of the filters along the slots.
+ */
+
+int Convolution::getPositions(int inputDimension) const
+  {
+  int slots = (inputDimension - lead)/width;
+
+  return (slots - kernel)/stride + 1;
+  }
+
+
+/**
+ * Return the number of outputs of each filter.
+ */
+
+int Convolution::getGroups(int inputDimension) const
+  {
+  return (getPositions(inputDimension) + pool - 1)/pool;
+  }
+
+
+/**
+ * Return whether a layer type is a Convolution.
+ */
+
+bool isConvolution(ActivationFunction* type)
+  {
+  return type->getName().compare(0, 5, "conv:") == 0;
+  }
@@ -0,0 +1,115 @@
+// file:    Convolution.h
+// purpose: Header file for Convolution class
+
+#ifndef __Convolution__
+#define __Convolution__
+
+#include <string>
+
+#include "ActivationFunction.h"
+
+/**
+ * A Convolution is the type of a ConvLayer: an activation function, which
+ * it passes on to, together with the shape of the convolution.
+ *
+ * The inputs are some lead inputs followed by slots of width inputs each.
+ * Each filter looks at the lead inputs and kernel consecutive slots, at
+ * every stride slots, and the largest net of each pool consecutive positions
+ * gives the output.
+ *
+ * Its name, which is how it is given to bp and saved with the weights, is
+ *
+ *   conv:<function>:<width>:<kernel>:<stride>:<pool>:<lead>
+ *
+ * e.g. conv:tansig:25:2:1:2:24 for the 16 slots of 25 inputs after the 24
+ * chord inputs of licks.in.
+ */
+
+class Convolution : public ActivationFunction
+{
+private:
+
+ActivationFunction* function;
+
+int width;
+
+int kernel;
+
+int stride;
+
+int pool;
+
+int lead;
+
+public:
+
+Convolution(ActivationFunction* _function, int _width, int _kernel, int _stride, int _pool,
+            int _lead);
+
+double act(double arg);
+
+double use(double arg);
+
+double deriv(double arg, double value);
+
+std::string getName();
+
+bool useMatchesAct();
+
+
+/**
+ * Return the activation function of the outputs.
+ */
+
+ActivationFunction* getFunction() const;
+
+int getWidth() const;
+
+int getKernel() const;
+
+int getStride() const;
+
+int getPool() const;
+
+int getLead() const;
+
+
+/**
+ * Return the number of inputs each filter looks at, not including its bias.
+ */
+
+int getWindow() const;
+
+
+/**
+ * Return whether the convolution fits a number of inputs: whole slots
+ * follow the lead inputs, and at least kernel of them.
+ */
+
+bool fits(int inputDimension) const;
+
+
+/**
+ * Return the number of positions of the filters along the slots.
+ */
+
+int getPositions(int inputDimension) const;
+
+
+/**
+ * Return the number of outputs of each filter: the positions pooled, the
+ * last pool taking the positions left over.
+ */
+
+int getGroups(int inputDimension) const;
+
+};
+
+
+/**
+ * Return whether a layer type is a Convolution.
+ */
+
+bool isConvolution(ActivationFunction* type);
+
+#endif
@@ -22,3 +22,8 @@ std::string Hardlim::getName()
   {
   return "hardlim";
   }
+
+bool Hardlim::useMatchesAct()
+  {
+  return false;
+  }
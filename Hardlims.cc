@@ -22,3 +22,8 @@ std::string Hardlims::getName()
   {
   return "hardlims";
   }
+
+bool Hardlims::useMatchesAct()
+  {
+  return false;
+  }
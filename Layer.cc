@@ -5,10 +5,15 @@
 // $Id: Layer.cc,v 1.3 2005/05/26 22:22:36 keller Exp keller $
 
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
 
 #include "Layer.h"
+#include "Matrix.h"
+
+std::string initName[] = {"uniform", "nguyen-widrow", "xavier", "he"};
 
 /**
  * constructor
@@ -16,6 +21,11 @@
 
 Layer::Layer()
   {
+  neuron = NULL;
+  weight = accumulated = oldAccumulated = updateValue = weightChange = NULL;
+  optimizerState = NULL;
+  optimizerStateLength = 0;
+  weightedSensitivity = NULL;
   }
 
 
@@ -23,9 +33,10 @@ Layer::Layer()
  * constructor
  */
 
-Layer::Layer(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs)
+Layer::Layer(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs,
+             Random& random)
   {
-  init(_layerIndex, _numberInLayer, _type, _numberOfInputs);
+  init(_layerIndex, _numberInLayer, _type, _numberOfInputs, random);
   }
 
 
@@ -36,7 +47,8 @@ Layer::Layer(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int
  * Randomize the weights of each Neuron.
  */
 
-void Layer::init(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs)
+void Layer::init(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs,
+                 Random& random)
   {
   layerIndex = _layerIndex;
 
@@ -44,11 +56,133 @@ void Layer::init(int _layerIndex, int _numberInLayer, ActivationFunction* _type,
 
   type = _type;
 
+  numberOfInputs = _numberOfInputs;
+
+  int rowSize = numberOfInputs+1;
+
   assert( neuron = new Neuron[numberInLayer] );
 
+  assert( weight = new double[numberInLayer*rowSize] );
+
+  assert( accumulated = new double[numberInLayer*rowSize] );
+
+  assert( oldAccumulated = new double[numberInLayer*rowSize] );
+
+  assert( updateValue = new double[numberInLayer*rowSize] );
+
+  assert( weightChange = new double[numberInLayer*rowSize] );
+
+  for( int k = 0; k < numberInLayer*rowSize; k++ )
+    {
+    weightChange[k] = 0;
+    }
+
+  optimizerState = NULL;
+  optimizerStateLength = 0;
+
+  assert( weightedSensitivity = new double[numberInLayer] );
+
   for( int i = 0; i < numberInLayer; i++ )
     {
-    neuron[i].init(layerIndex, i, type, _numberOfInputs);	// initialize neuron and weights
+    int row = i*rowSize;
+
+    neuron[i].init(layerIndex, i, type, numberOfInputs,		// initialize neuron
+                   weight + row, accumulated + row, oldAccumulated + row, updateValue + row);
+    }
+
+  initWeights(UNIFORM_INIT, random);
+  }
+
+
+/**
+ * Randomize the weights, including the biases, by a scheme.
+ */
+
+void Layer::initWeights(INIT scheme, Random& random)
+  {
+  int rowSize = numberOfInputs+1;
+
+  switch( scheme )
+    {
+    case UNIFORM_INIT:
+      for( int k = 0; k < numberInLayer*rowSize; k++ )
+        {
+        weight[k] = random.uniform()-0.5;
+        }
+      break;
+
+    case NGUYEN_WIDROW:
+      {
+      // Each neuron's input weights get length beta, in a random direction,
+      // and its bias is uniform on [-beta, beta], so that the neurons' active
+      // regions tile inputs in [-1, 1].  That of logsig is twice as wide as
+      // that of tansig.
+
+      double beta = 0.7*pow((double)numberInLayer, 1.0/numberOfInputs);
+
+      if( type->getName() == "logsig" )
+        {
+        beta *= 2;
+        }
+
+      for( int i = 0; i < numberInLayer; i++ )
+        {
+        double* row = weight + i*rowSize;
+        double norm = 0;
+
+        for( int j = 0; j < numberOfInputs; j++ )
+          {
+          row[j] = random.uniform()-0.5;
+          norm += row[j]*row[j];
+          }
+
+        norm = sqrt(norm);
+
+        for( int j = 0; j < numberOfInputs; j++ )
+          {
+          row[j] *= norm > 0 ? beta/norm : 0;
+          }
+
+        row[numberOfInputs] = beta*(2*random.uniform()-1);
+        }
+      }
+      break;
+
+    case XAVIER:
+      {
+      double limit = sqrt(6.0/(numberOfInputs + numberInLayer));
+
+      for( int i = 0; i < numberInLayer; i++ )
+        {
+        double* row = weight + i*rowSize;
+
+        for( int j = 0; j < numberOfInputs; j++ )
+          {
+          row[j] = limit*(2*random.uniform()-1);
+          }
+
+        row[numberOfInputs] = 0;
+        }
+      }
+      break;
+
+    case HE:
+      {
+      double deviation = sqrt(2.0/numberOfInputs);
+
+      for( int i = 0; i < numberInLayer; i++ )
+        {
+        double* row = weight + i*rowSize;
+
+        for( int j = 0; j < numberOfInputs; j++ )
+          {
+          row[j] = deviation*random.normal();
+          }
+
+        row[numberOfInputs] = 0;
+        }
+      }
+      break;
     }
   }
 
@@ -72,6 +206,26 @@ int Layer::getSize() const
   return numberInLayer;
   }
 
+
+/**
+ * Return the number of Neurons holding the weights of this Layer.
+ */
+
+int Layer::getNumberOfNeurons() const
+  {
+  return numberInLayer;
+  }
+
+
+/**
+ * Return the number of inputs to each neuron in this Layer.
+ */
+
+int Layer::getNumberOfInputs() const
+  {
+  return numberOfInputs;
+  }
+
 std::string Layer::getType() const
 {
   return type->getName();
@@ -112,6 +266,16 @@ void Layer::use(const Source& source)
   }
 
 
+/**
+ * Return whether using this Layer gives the same outputs as firing it.
+ */
+
+bool Layer::useMatchesFire() const
+  {
+  return type->useMatchesAct();
+  }
+
+
 /**
  * Get the sum of the weighted sensitivities from the ith neuron of the previous layer.
  */
@@ -127,6 +291,42 @@ double Layer::getSumWeightedSensitivity(int i) const
   }
 
 
+/**
+ * Get the sums of the weighted sensitivities for all neurons of the
+ * previous layer at once, in an array of numberOfInputs values.
+ *
+ * This is the transposed weight matrix times the sensitivities, formed by
+ * adding each neuron's weight row, scaled by its sensitivity, so that the
+ * weights are read contiguously rather than a column at a time.
+ */
+
+void Layer::getSumsWeightedSensitivity(double* sums) const
+  {
+  int rowSize = numberOfInputs+1;
+
+  for( int i = 0; i < numberOfInputs; i++ )
+    {
+    sums[i] = 0;
+    }
+
+  for( int j = 0; j < numberInLayer; j++ )
+    {
+    double sensitivity = neuron[j].getSensitivity();
+    const double* row = weight + j*rowSize;
+
+    if( sensitivity == 0 )
+      {
+      continue;
+      }
+
+    for( int i = 0; i < numberOfInputs; i++ )
+      {
+      sums[i] += sensitivity*row[i];
+      }
+    }
+  }
+
+
 /**
  * Set weight to a specific values
  */
@@ -140,13 +340,20 @@ void Layer::setWeight(int i, int j, double weight)
 
 /**
  * Adjust the weights on each neuron in this layer.
+ *
+ * Here and in accumulating, a neuron whose sensitivity is 0 would change
+ * nothing, and is skipped; a OnehotLayer sampling negatives leaves most
+ * of its neurons so.
  */
 
 void Layer::adjustWeights(const Source& source, double rate)
   {
   for( int i = 0 ; i < numberInLayer; i++ )
     {
-    neuron[i].adjustWeights(source, rate);
+    if( neuron[i].getSensitivity() != 0 )
+      {
+      neuron[i].adjustWeights(source, rate);
+      }
     }
   }
 
@@ -159,7 +366,10 @@ void Layer::accumulateWeights(const Source& source, double rate)
   {
   for( int i = 0 ; i < numberInLayer; i++ )
     {
-    neuron[i].accumulateWeights(source, rate);
+    if( neuron[i].getSensitivity() != 0 )
+      {
+      neuron[i].accumulateWeights(source, rate);
+      }
     }
   }
 
@@ -168,7 +378,10 @@ void Layer::accumulateGradient(const Source& source)
   {
   for( int i = 0 ; i < numberInLayer; i++ )
     {
-    neuron[i].accumulateGradient(source);
+    if( neuron[i].getSensitivity() != 0 )
+      {
+      neuron[i].accumulateGradient(source);
+      }
     }
   }
 
@@ -190,15 +403,131 @@ void Layer::installAccumulation()
     }
   }
 
-void Layer::adjustByRprop(double etaPlus, double etaMinus)
+/**
+ * Start rprop afresh: every step size is set to the initial one
+ * and the previous gradients and weight changes are forgotten.
+ */
+
+void Layer::resetRprop(const Rprop& rprop)
   {
-  for( int i = 0 ; i < numberInLayer; i++ )
+  int n = numberInLayer*(numberOfInputs+1);
+
+  for( int k = 0; k < n; k++ )
+    {
+    updateValue[k] = rprop.getDeltaInit();
+    oldAccumulated[k] = 0;
+    weightChange[k] = 0;
+    }
+  }
+
+
+/**
+ * Apply one rprop step to all weights of the layer, using the accumulated gradient.
+ * The weights of all neurons are contiguous, so this is a single kernel call.
+ */
+
+void Layer::adjustByRprop(const Rprop& rprop, bool errorIncreased)
+  {
+  rprop.adjust(numberInLayer*(numberOfInputs+1),
+               weight, accumulated, oldAccumulated, updateValue, weightChange,
+               errorIncreased);
+  }
+
+
+
+/**
+ * Allocate and clear the state that an Optimizer keeps for the weights.
+ */
+
+void Layer::initOptimizer(const Optimizer& optimizer)
+  {
+  int n = optimizer.getStateSize()*numberInLayer*(numberOfInputs+1);
+
+  delete [] optimizerState;
+
+  assert( optimizerState = new double[n > 0 ? n : 1] );
+
+  optimizerStateLength = n;
+
+  for( int k = 0; k < n; k++ )
+    {
+    optimizerState[k] = 0;
+    }
+  }
+
+
+/**
+ * Save or restore the weights and the training state kept with them
+ * (rprop step sizes, previous gradients and changes, Optimizer state).
+ */
+
+void Layer::saveState(Checkpoint& checkpoint) const
+  {
+  int n = getParameterCount();
+
+  checkpoint.putInt(numberInLayer);
+  checkpoint.putInt(numberOfInputs);
+
+  checkpoint.putDoubles(weight, n);
+  checkpoint.putDoubles(accumulated, n);
+  checkpoint.putDoubles(oldAccumulated, n);
+  checkpoint.putDoubles(updateValue, n);
+  checkpoint.putDoubles(weightChange, n);
+
+  checkpoint.putInt(optimizerStateLength);
+  checkpoint.putDoubles(optimizerState, optimizerStateLength);
+  }
+
+void Layer::loadState(Checkpoint& checkpoint)
+  {
+  int n = getParameterCount();
+
+  if( checkpoint.getInt() != numberInLayer || checkpoint.getInt() != numberOfInputs )
     {
-    neuron[i].adjustByRprop(etaPlus, etaMinus);
+    printf("error, the checkpoint's layer %d does not match the network\n", layerIndex);
+    exit(1);
     }
+
+  checkpoint.getDoubles(weight, n);
+  checkpoint.getDoubles(accumulated, n);
+  checkpoint.getDoubles(oldAccumulated, n);
+  checkpoint.getDoubles(updateValue, n);
+  checkpoint.getDoubles(weightChange, n);
+
+  int length = checkpoint.getInt();
+
+  delete [] optimizerState;
+  optimizerState = NULL;
+
+  if( length > 0 )
+    {
+    assert( optimizerState = new double[length] );
+    checkpoint.getDoubles(optimizerState, length);
+    }
+
+  optimizerStateLength = length;
   }
 
 
+/**
+ * Let an Optimizer update the weights from the accumulated gradient, scaled
+ * by scale, and clear the accumulation.
+ */
+
+void Layer::adjustByOptimizer(const Optimizer& optimizer, double rate, double scale)
+  {
+  assert( optimizerState );
+
+  int n = numberInLayer*(numberOfInputs+1);
+
+  optimizer.adjust(n, weight, accumulated, optimizerState, rate, scale);
+
+  for( int k = 0; k < n; k++ )
+    {
+    accumulated[k] = 0;
+    }
+  }
+
 
 /**
  * Show the weights on each neuron in this layer on the standard output stream.
@@ -253,9 +582,13 @@ for( int i = 0; i < numberInLayer; i++ )
 
 void Layer::setSensitivity(const Layer& nextLayer)
   {
+  assert( nextLayer.numberOfInputs == numberInLayer );
+
+  nextLayer.getSumsWeightedSensitivity(weightedSensitivity);
+
   for( int i = 0; i < numberInLayer; i++ )
     {
-    neuron[i].setSensitivity(nextLayer.getSumWeightedSensitivity(i));
+    neuron[i].setSensitivity(weightedSensitivity[i]);
     }
   }
 
@@ -281,6 +614,19 @@ void Layer::setFixedSensitivity(int i, double sensitivity)
   neuron[i].setFixedSensitivity(sensitivity);
   }
 
+
+/**
+ * Multiply the sensitivity of every Neuron by a factor.
+ */
+
+void Layer::scaleSensitivity(double factor)
+  {
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    neuron[i].setFixedSensitivity(factor*neuron[i].getSensitivity());
+    }
+  }
+
 /**
  * Compute the error of the Output Layer,
  * based on the value in Sample.
@@ -301,7 +647,302 @@ double Layer::computeError(const Sample& sample) const
 
 
 
+/**
+ * Fire the layer on a batch of inputs, given as a matrix with one row of
+ * numberOfInputs values per sample, setting the corresponding rows of the
+ * output and derivative matrices.
+ *
+ * The net values are the product of the input matrix with the transposed
+ * weight matrix (without its bias column), plus the biases.
+ */
+
+void Layer::fireBatch(const double* input, int batchSize, double* output, double* deriv) const
+  {
+  int rowSize = numberOfInputs+1;
+
+  multiplyTransposed(batchSize, numberInLayer, numberOfInputs,
+                     input, numberOfInputs,
+                     weight, rowSize,
+                     output, numberInLayer);
+
+  for( int b = 0; b < batchSize; b++ )
+    {
+    double* outputRow = output + b*numberInLayer;
+    double* derivRow = deriv + b*numberInLayer;
+
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      double net = outputRow[i] + weight[i*rowSize + numberOfInputs];	// bias component
+
+      outputRow[i] = type->act(net);
+
+      derivRow[i] = type->deriv(net, outputRow[i]);
+      }
+    }
+  }
+
+
+/**
+ * Get the ith output value of the layer from one row of a batch output matrix.
+ */
+
+double Layer::getBatchOutput(const double* outputRow, int i) const
+  {
+  return outputRow[i];
+  }
+
+
+/**
+ * Set the sensitivities of an output layer for a batch, based on the Samples.
+ */
+
+void Layer::setSensitivityBatch(const Sample* const* samples, int batchSize,
+                                const double* output, const double* deriv,
+                                double* sensitivity) const
+  {
+  for( int b = 0; b < batchSize; b++ )
+    {
+    int row = b*numberInLayer;
+
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      double error = samples[b]->getOutput(i) - output[row + i];
+      sensitivity[row + i] = -2 * error * deriv[row + i];
+      }
+    }
+  }
+
+
+/**
+ * Set the sensitivities of a hidden layer for a batch, based on the
+ * sensitivities of the next Layer.
+ *
+ * The weighted sums are the product of the next layer's sensitivity matrix
+ * with its weight matrix (without the bias column).
+ */
+
+void Layer::setSensitivityBatch(const Layer& nextLayer, const double* nextSensitivity, int batchSize,
+                                const double* deriv, double* sensitivity) const
+  {
+  int size = getSize();		// the outputs, in the case of a ConvLayer
+
+  assert( nextLayer.numberOfInputs == size );
+
+  multiply(batchSize, size, nextLayer.numberInLayer,
+           nextSensitivity, nextLayer.numberInLayer,
+           nextLayer.weight, nextLayer.numberOfInputs+1,
+           sensitivity, size);
+
+  for( int k = 0; k < batchSize*size; k++ )
+    {
+    sensitivity[k] *= deriv[k];
+    }
+  }
+
+
+/**
+ * Accumulate the gradient for a batch of inputs and sensitivities.
+ *
+ * The weight gradient is the product of the transposed sensitivity matrix
+ * with the input matrix; the bias gradient is the column sum of sensitivities.
+ */
+
+void Layer::accumulateGradientBatch(const double* input, const double* sensitivity, int batchSize)
+  {
+  addGradientBatch(input, sensitivity, batchSize, accumulated);
+  }
+
+
+/**
+ * Add the gradient of this Layer over a Batch, as accumulateGradientBatch
+ * does, into an array shaped like the weights instead.
+ */
+
+void Layer::addGradientBatch(const double* input, const double* sensitivity, int batchSize,
+                             double* gradient) const
+  {
+  int rowSize = numberOfInputs+1;
+
+  accumulateTransposed(numberInLayer, numberOfInputs, batchSize,
+                       sensitivity, numberInLayer,
+                       input, numberOfInputs,
+                       gradient, rowSize);
+
+  for( int b = 0; b < batchSize; b++ )
+    {
+    const double* sensitivityRow = sensitivity + b*numberInLayer;
+
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      gradient[i*rowSize + numberOfInputs] += sensitivityRow[i];
+      }
+    }
+  }
+
+
+/**
+ * Move the weights against the accumulated gradient, scaled by rate,
+ * and clear the accumulation.
+ */
+
+void Layer::descendGradient(double rate)
+  {
+  int n = numberInLayer*(numberOfInputs+1);
+
+  for( int k = 0; k < n; k++ )
+    {
+    weight[k] -= rate*accumulated[k];
+    accumulated[k] = 0;
+    }
+  }
+
+
+/**
+ * Compute the loss of an output layer on a fired Sample: the sum of the
+ * squared errors, whose gradient setSensitivity(sample) backpropagates.
+ */
+
+double Layer::computeLoss(const Sample& sample) const
+  {
+  return Layer::computeError(sample);
+  }
+
+
+/**
+ * Get the ith residual (desired minus actual output) of an output layer on
+ * a fired Sample.  The loss is the sum of the squared residuals.
+ */
+
+double Layer::getResidual(const Sample& sample, int i) const
+  {
+  return sample.getOutput(i) - neuron[i].getOutput();
+  }
+
+
+/**
+ * Set the sensitivities of an output layer to the derivatives of its ith
+ * residual, in preparation for backpropagating them.
+ */
+
+void Layer::setResidualSensitivity(int i)
+  {
+  for( int k = 0; k < numberInLayer; k++ )
+    {
+    neuron[k].setSensitivity(k == i ? -1 : 0);
+    }
+  }
+
+
+/**
+ * Store the gradient of every weight of this Layer for the current
+ * sensitivities in an array, row by row, without accumulating it.
+ */
+
+void Layer::getGradientRow(const Source& source, double* row) const
+  {
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    neuron[i].getGradient(source, row + i*(numberOfInputs+1));
+    }
+  }
+
+
+/**
+ * Compute the loss of an output layer on a Sample from its row of a batch
+ * output matrix.
+ */
+
+double Layer::computeLoss(const Sample& sample, const double* outputRow) const
+  {
+  double sse = 0;
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    double error = sample.getOutput(i) - outputRow[i];
+    sse += error*error;
+    }
+  return sse;
+  }
+
+
+/**
+ * Return the number of weights in this Layer, including the biases.
+ */
+
+int Layer::getParameterCount() const
+  {
+  return numberInLayer*(numberOfInputs+1);
+  }
+
+
+/**
+ * Copy the weights of this Layer, row by row, into an array.
+ */
+
+void Layer::getWeights(double* values) const
+  {
+  int n = getParameterCount();
+
+  for( int k = 0; k < n; k++ )
+    {
+    values[k] = weight[k];
+    }
+  }
+
+
+/**
+ * Set the weights of this Layer, row by row, from an array.
+ */
+
+void Layer::setWeights(const double* values)
+  {
+  int n = getParameterCount();
+
+  for( int k = 0; k < n; k++ )
+    {
+    weight[k] = values[k];
+    }
+  }
+
+
+/**
+ * Copy the accumulated gradient of this Layer into an array.
+ */
+
+void Layer::getGradient(double* values) const
+  {
+  int n = getParameterCount();
+
+  for( int k = 0; k < n; k++ )
+    {
+    values[k] = accumulated[k];
+    }
+  }
+
+
+/**
+ * Set the accumulated gradient of this Layer from an array.
+ */
+
+void Layer::setGradient(const double* values)
+  {
+  int n = getParameterCount();
+
+  for( int k = 0; k < n; k++ )
+    {
+    accumulated[k] = values[k];
+    }
+  }
+
+
+
 Layer::~Layer()
   {
   delete [] neuron;
+  delete [] weight;
+  delete [] accumulated;
+  delete [] oldAccumulated;
+  delete [] updateValue;
+  delete [] weightChange;
+  delete [] optimizerState;
+  delete [] weightedSensitivity;
   }
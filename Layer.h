@@ -9,10 +9,22 @@
 #include <string>
 
 #include "ActivationFunction.h"
+#include "Checkpoint.h"
 #include "Neuron.h"
+#include "Optimizer.h"
+#include "Random.h"
+#include "Rprop.h"
 #include "Sample.h"
 #include "Source.h"
 
+/**
+ * schemes for the initial weights of a Layer
+ */
+
+enum INIT {UNIFORM_INIT = 0, NGUYEN_WIDROW = 1, XAVIER = 2, HE = 3};
+
+extern std::string initName[];
+
 /**
  * A Layer is a layer of Neurons
  */
@@ -36,6 +48,49 @@ int numberInLayer;
 Neuron* neuron;
 
 
+/**
+ * the number of inputs to each Neuron, not including the bias
+ */
+
+int numberOfInputs;
+
+
+/**
+ * contiguous storage for the Neurons: numberInLayer rows of
+ * numberOfInputs+1 values, the last value in each row being for the bias
+ */
+
+double* weight;
+
+double* accumulated;
+
+double* oldAccumulated;
+
+double* updateValue;
+
+/**
+ * the most recent change of each weight, in the case of rprop
+ */
+
+double* weightChange;
+
+/**
+ * the state of an Optimizer, laid out as getStateSize() arrays shaped like
+ * the weights, allocated when the Optimizer is installed
+ */
+
+double* optimizerState;
+
+int optimizerStateLength;
+
+/**
+ * for each Neuron, the sum of the weighted sensitivities from the next
+ * Layer, computed when backpropagating
+ */
+
+double* weightedSensitivity;
+
+
 /**
  * the index of this layer (for tracing purposes)
  */
@@ -55,7 +110,8 @@ Layer();
  * constructor
  */
 
-Layer(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs);
+Layer(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs,
+      Random& random);
 
 
 /**
@@ -65,7 +121,23 @@ Layer(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _number
  * Randomize the weights of each Neuron.
  */
 
-void init(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs);
+void init(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs,
+          Random& random);
+
+
+/**
+ * Randomize the weights, including the biases, by a scheme:
+ *
+ * UNIFORM_INIT, uniform on [-0.5, 0.5), whatever the fan-in;
+ * NGUYEN_WIDROW, for logsig and tansig layers, which spreads the neurons'
+ *   active regions over the inputs (Nguyen and Widrow, 1990);
+ * XAVIER, uniform with variance 2/(fan-in + fan-out) (Glorot and Bengio, 2010);
+ * HE, normal with variance 2/fan-in (He et al., 2015).
+ *
+ * The last three start the biases at 0, except Nguyen-Widrow's.
+ */
+
+void initWeights(INIT scheme, Random& random);
 
 
 /**
@@ -76,12 +148,29 @@ int getIndex() const;
 
 
 /**
- * Return the number of neurons in this Layer.
+ * Return the number of neurons in this Layer: its outputs.
+ */
+
+virtual int getSize() const;
+
+
+/**
+ * Return the number of Neurons holding the weights of this Layer, one row
+ * each.  That is its size, except in a ConvLayer, whose filters are shared
+ * by its outputs.
  */
 
-int getSize() const;
+int getNumberOfNeurons() const;
 
-std::string getType() const;
+
+/**
+ * Return the number of inputs to each neuron in this Layer (to each filter,
+ * in a ConvLayer).
+ */
+
+int getNumberOfInputs() const;
+
+virtual std::string getType() const;
 
 /**
  * Get the output value of the ith neuron in this layer.
@@ -97,6 +186,14 @@ virtual double get(int i) const;
 double getSumWeightedSensitivity(int i) const;
 
 
+/**
+ * Get the sums of the weighted sensitivities for all neurons of the
+ * previous layer at once, in an array of numberOfInputs values.
+ */
+
+void getSumsWeightedSensitivity(double* sums) const;
+
+
 /**
  * Set the weight to a specific value.
  */
@@ -116,6 +213,13 @@ virtual void fire(const Source& source);
 virtual void use(const Source& source);
 
 
+/**
+ * Return whether using this Layer gives the same outputs as firing it.
+ */
+
+bool useMatchesFire() const;
+
+
 /**
  * Return a reference to the neuron at the specified index.
  */
@@ -127,18 +231,55 @@ Neuron& operator[](int index);
  * Adjust the weights on each neuron in this layer.
  */
 
-void adjustWeights(const Source& source, double rate);
+virtual void adjustWeights(const Source& source, double rate);
 
 
-void accumulateWeights(const Source& source, double rate);
+virtual void accumulateWeights(const Source& source, double rate);
 
-void accumulateGradient(const Source& source);
+virtual void accumulateGradient(const Source& source);
 
 void clearAccumulation();
 
 void installAccumulation();
 
-void adjustByRprop(double etaPlus, double etaMinus);
+/**
+ * Start rprop afresh: every step size is set to the initial one
+ * and the previous gradients and weight changes are forgotten.
+ */
+
+void resetRprop(const Rprop& rprop);
+
+
+/**
+ * Apply one rprop step to all weights of the layer, using the accumulated gradient.
+ */
+
+void adjustByRprop(const Rprop& rprop, bool errorIncreased);
+
+
+/**
+ * Allocate and clear the state that an Optimizer keeps for the weights.
+ */
+
+void initOptimizer(const Optimizer& optimizer);
+
+
+/**
+ * Let an Optimizer update the weights from the accumulated gradient, scaled
+ * by scale, and clear the accumulation.
+ */
+
+void adjustByOptimizer(const Optimizer& optimizer, double rate, double scale);
+
+
+/**
+ * Save or restore the weights and the training state kept with them
+ * (rprop step sizes, previous gradients and changes, Optimizer state).
+ */
+
+virtual void saveState(Checkpoint& checkpoint) const;
+
+virtual void loadState(Checkpoint& checkpoint);
 
 
 /**
@@ -162,6 +303,13 @@ void saveWeights(std::ofstream& weightStream);
 
 void setFixedSensitivity(int i, double sensitivity);
 
+
+/**
+ * Multiply the sensitivity of every Neuron by a factor.
+ */
+
+virtual void scaleSensitivity(double factor);
+
 /**
  * Save the network output to a file.
  */
@@ -182,6 +330,139 @@ virtual void setSensitivity(const Sample& sample);
 virtual double computeError(const Sample& sample) const;
 
 
+/**
+ * Compute the loss of an output layer on a fired Sample: the quantity whose
+ * gradient setSensitivity(sample) backpropagates.
+ */
+
+virtual double computeLoss(const Sample& sample) const;
+
+
+/**
+ * Compute the loss of an output layer on a Sample from its row of a batch
+ * output matrix.
+ */
+
+virtual double computeLoss(const Sample& sample, const double* outputRow) const;
+
+
+/**
+ * Get the ith residual (desired minus actual output) of an output layer on
+ * a fired Sample.  The loss is the sum of the squared residuals.
+ */
+
+virtual double getResidual(const Sample& sample, int i) const;
+
+
+/**
+ * Set the sensitivities of an output layer to the derivatives of its ith
+ * residual, in preparation for backpropagating them.
+ */
+
+void setResidualSensitivity(int i);
+
+
+/**
+ * Store the gradient of every weight of this Layer for the current
+ * sensitivities in an array, row by row, without accumulating it.
+ */
+
+virtual void getGradientRow(const Source& source, double* row) const;
+
+
+/**
+ * Return the number of weights in this Layer, including the biases.
+ */
+
+int getParameterCount() const;
+
+
+/**
+ * Copy the weights of this Layer, row by row, into an array.
+ */
+
+void getWeights(double* values) const;
+
+
+/**
+ * Set the weights of this Layer, row by row, from an array.
+ */
+
+void setWeights(const double* values);
+
+
+/**
+ * Copy the accumulated gradient of this Layer into an array.
+ */
+
+void getGradient(double* values) const;
+
+
+/**
+ * Set the accumulated gradient of this Layer from an array.
+ */
+
+void setGradient(const double* values);
+
+
+/**
+ * Fire the layer on a batch of inputs, given as a matrix with one row of
+ * numberOfInputs values per sample, setting the corresponding rows of the
+ * output and derivative matrices.
+ */
+
+virtual void fireBatch(const double* input, int batchSize, double* output, double* deriv) const;
+
+
+/**
+ * Get the ith output value of the layer from one row of a batch output matrix.
+ */
+
+virtual double getBatchOutput(const double* outputRow, int i) const;
+
+
+/**
+ * Set the sensitivities of an output layer for a batch, based on the Samples.
+ */
+
+virtual void setSensitivityBatch(const Sample* const* samples, int batchSize,
+                                 const double* output, const double* deriv,
+                                 double* sensitivity) const;
+
+
+/**
+ * Set the sensitivities of a hidden layer for a batch, based on the
+ * sensitivities of the next Layer.
+ */
+
+void setSensitivityBatch(const Layer& nextLayer, const double* nextSensitivity, int batchSize,
+                         const double* deriv, double* sensitivity) const;
+
+
+/**
+ * Accumulate the gradient for a batch of inputs and sensitivities.
+ */
+
+void accumulateGradientBatch(const double* input, const double* sensitivity, int batchSize);
+
+
+/**
+ * Add the gradient of this Layer over a Batch, as accumulateGradientBatch
+ * does, into an array shaped like the weights instead.
+ */
+
+virtual void addGradientBatch(const double* input, const double* sensitivity, int batchSize,
+                              double* gradient) const;
+
+
+/**
+ * Move the weights against the accumulated gradient, scaled by rate,
+ * and clear the accumulation.
+ */
+
+void descendGradient(double rate);
+
+
 /**
  * Destructor
  */
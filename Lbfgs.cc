@@ -0,0 +1,197 @@
+// file:    Lbfgs.cc
+// purpose: C++ code for Lbfgs class
+
+#include "Lbfgs.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static double dot(int n, const double* a, const double* b)
+  {
+  double sum = 0;
+  for( int j = 0; j < n; j++ )
+    {
+    sum += a[j]*b[j];
+    }
+  return sum;
+  }
+
+
+/**
+ * constructor, for n parameters and the given number of remembered pairs
+ */
+
+Lbfgs::Lbfgs(int _n, int _memory)
+  {
+  assert( _n > 0 && _memory > 0 );
+
+  n = _n;
+  memory = _memory;
+
+  assert( s = new double[memory*n] );
+  assert( y = new double[memory*n] );
+  assert( rho = new double[memory] );
+  assert( alpha = new double[memory] );
+
+  reset();
+  }
+
+
+/**
+ * Forget all pairs, so the next direction is steepest descent.
+ */
+
+void Lbfgs::reset()
+  {
+  count = 0;
+  newest = memory-1;
+  }
+
+
+/**
+ * Save or restore the remembered pairs.
+ */
+
+void Lbfgs::saveState(Checkpoint& checkpoint) const
+  {
+  checkpoint.putInt(n);
+  checkpoint.putInt(memory);
+  checkpoint.putInt(count);
+  checkpoint.putInt(newest);
+  checkpoint.putDoubles(s, memory*n);
+  checkpoint.putDoubles(y, memory*n);
+  checkpoint.putDoubles(rho, memory);
+  }
+
+void Lbfgs::loadState(Checkpoint& checkpoint)
+  {
+  if( checkpoint.getInt() != n || checkpoint.getInt() != memory )
+    {
+    printf("error, the checkpoint's lbfgs memory does not match\n");
+    exit(1);
+    }
+
+  count = checkpoint.getInt();
+  newest = checkpoint.getInt();
+  checkpoint.getDoubles(s, memory*n);
+  checkpoint.getDoubles(y, memory*n);
+  checkpoint.getDoubles(rho, memory);
+  }
+
+
+/**
+ * Get the number of pairs currently remembered.
+ */
+
+int Lbfgs::getCount() const
+  {
+  return count;
+  }
+
+
+/**
+ * Set direction to the quasi-Newton direction -H*gradient, by the two-loop
+ * recursion, starting from the scaled identity (s.y)/(y.y) of the newest pair.
+ */
+
+void Lbfgs::computeDirection(const double* gradient, double* direction)
+  {
+  for( int j = 0; j < n; j++ )
+    {
+    direction[j] = -gradient[j];
+    }
+
+  // newest to oldest
+
+  for( int k = 0; k < count; k++ )
+    {
+    int row = (newest - k + memory) % memory;
+    const double* sRow = s + row*n;
+    const double* yRow = y + row*n;
+
+    alpha[row] = rho[row]*dot(n, sRow, direction);
+
+    for( int j = 0; j < n; j++ )
+      {
+      direction[j] -= alpha[row]*yRow[j];
+      }
+    }
+
+  if( count > 0 )
+    {
+    const double* yNewest = y + newest*n;
+    double gamma = 1/(rho[newest]*dot(n, yNewest, yNewest));
+
+    for( int j = 0; j < n; j++ )
+      {
+      direction[j] *= gamma;
+      }
+    }
+
+  // oldest to newest
+
+  for( int k = count-1; k >= 0; k-- )
+    {
+    int row = (newest - k + memory) % memory;
+    const double* sRow = s + row*n;
+    const double* yRow = y + row*n;
+
+    double beta = rho[row]*dot(n, yRow, direction);
+
+    for( int j = 0; j < n; j++ )
+      {
+      direction[j] += (alpha[row] - beta)*sRow[j];
+      }
+    }
+  }
+
+
+/**
+ * Remember a step and the gradient change it caused.  Pairs without
+ * positive curvature are skipped, returning false.
+ */
+
+bool Lbfgs::update(const double* step, const double* gradientChange)
+  {
+  double ys = dot(n, gradientChange, step);
+
+  if( !(ys > 1e-10*dot(n, gradientChange, gradientChange)) )
+    {
+    return false;
+    }
+
+  newest = (newest+1) % memory;
+
+  double* sRow = s + newest*n;
+  double* yRow = y + newest*n;
+
+  for( int j = 0; j < n; j++ )
+    {
+    sRow[j] = step[j];
+    yRow[j] = gradientChange[j];
+    }
+
+  rho[newest] = 1/ys;
+
+  if( count < memory )
+    {
+    count++;
+    }
+
+  return true;
+  }
+
+
+/**
+ * destructor
+ */
+
+Lbfgs::~Lbfgs()
+  {
+  delete [] s;
+  delete [] y;
+  delete [] rho;
+  delete [] alpha;
+  }
@@ -0,0 +1,111 @@
+// file:    Lbfgs.h
+// purpose: Header file for Lbfgs class
+
+#ifndef __Lbfgs__
+#define __Lbfgs__
+
+#include "Checkpoint.h"
+
+/**
+ * Lbfgs keeps the limited-memory BFGS approximation of the inverse Hessian:
+ * the most recent steps s and gradient changes y, as rows of two
+ * memory x n matrices used as rings.  It turns a gradient into a search
+ * direction by the two-loop recursion; the line search is up to the caller.
+ */
+
+class Lbfgs
+{
+private:
+
+/**
+ * the number of parameters
+ */
+
+int n;
+
+/**
+ * the number of (s, y) pairs remembered
+ */
+
+int memory;
+
+/**
+ * the number of pairs currently held, and the row of the newest
+ */
+
+int count;
+
+int newest;
+
+double* s;
+
+double* y;
+
+/**
+ * 1/(y.s) for each pair
+ */
+
+double* rho;
+
+/**
+ * scratch for the two-loop recursion
+ */
+
+double* alpha;
+
+public:
+
+/**
+ * constructor, for n parameters and the given number of remembered pairs
+ */
+
+Lbfgs(int _n, int _memory);
+
+
+/**
+ * Forget all pairs, so the next direction is steepest descent.
+ */
+
+void reset();
+
+
+/**
+ * Get the number of pairs currently remembered.
+ */
+
+int getCount() const;
+
+
+/**
+ * Set direction to the quasi-Newton direction -H*gradient.
+ */
+
+void computeDirection(const double* gradient, double* direction);
+
+
+/**
+ * Remember a step and the gradient change it caused.  Pairs without
+ * positive curvature are skipped, returning false.
+ */
+
+bool update(const double* step, const double* gradientChange);
+
+
+/**
+ * Save or restore the remembered pairs.
+ */
+
+void saveState(Checkpoint& checkpoint) const;
+
+void loadState(Checkpoint& checkpoint);
+
+
+/**
+ * destructor
+ */
+
+~Lbfgs();
+
+}; // class Lbfgs
+
+#endif
@@ -0,0 +1,283 @@
+// file:    LevenbergMarquardt.cc
+// purpose: C++ code for LevenbergMarquardt class
+
+#include "LevenbergMarquardt.h"
+#include "Matrix.h"
+
+#include <assert.h>
+
+/**
+ * the number of rows of J formed at once in the P x P case
+ */
+
+const int lmBlockRows = 64;
+
+
+/**
+ * constructor, for a Network and the Samples it is trained on
+ */
+
+LevenbergMarquardt::LevenbergMarquardt(Network& _network,
+                                       const std::vector<Sample*>& _samples,
+                                       double _mu)
+  : network(_network), samples(_samples)
+  {
+  mu = _mu;
+  muMin = 1e-20;
+  muMax = 1e10;
+
+  parameterCount = network.getParameterCount();
+  residualCount = samples.size()*network.getResidualCount();
+
+  dual = residualCount < parameterCount;
+
+  order = dual ? residualCount : parameterCount;
+  blockRows = dual ? residualCount : lmBlockRows;
+
+  assert( jacobian = new double[blockRows*parameterCount] );
+  assert( residual = new double[blockRows] );
+  assert( system = new double[order*order] );
+  assert( factor = new double[order*order] );
+  assert( rhs = new double[order] );
+  assert( gradient = new double[parameterCount] );
+  assert( weights = new double[parameterCount] );
+  assert( step = new double[parameterCount] );
+  }
+
+
+/**
+ * Return the memory, in megabytes, needed to train a Network on a number
+ * of Samples.
+ */
+
+double LevenbergMarquardt::getMegabytesNeeded(const Network& network, int numberSamples)
+  {
+  double p = network.getParameterCount();
+  double r = (double)numberSamples*network.getResidualCount();
+
+  double order = r < p ? r : p;
+  double rows = r < p ? r : lmBlockRows;
+
+  double values = rows*p + rows + 2*order*order + order + 3*p;
+
+  return values*sizeof(double)/(1024*1024);
+  }
+
+
+/**
+ * Fire the Network on every Sample at the current weights and form the
+ * system and right hand side.  Returns the loss, and sets sse to the
+ * summed error.
+ *
+ * In the R x R case the system is J J^T, formed once all of J is known.
+ * In the P x P case each block of rows adds to J^T J and J^T e.
+ */
+
+double LevenbergMarquardt::formSystem(double& sse)
+  {
+  int residualsPerSample = network.getResidualCount();
+  int p = parameterCount;
+
+  double loss = 0;
+  sse = 0;
+
+  if( !dual )
+    {
+    for( int k = 0; k < order*order; k++ )
+      {
+      system[k] = 0;
+      }
+
+    for( int j = 0; j < p; j++ )
+      {
+      gradient[j] = 0;
+      }
+    }
+
+  int row = 0;
+
+  for( std::vector<Sample*>::const_iterator sample = samples.begin();
+       sample != samples.end();
+       sample++
+     )
+    {
+    network.fire(**sample);
+
+    sse += network.computeError(**sample);
+
+    loss += network.computeLoss(**sample);
+
+    for( int k = 0; k < residualsPerSample; k++ )
+      {
+      residual[row] = network.getResidual(**sample, k);
+
+      network.getJacobianRow(**sample, k, jacobian + row*p);
+
+      row++;
+
+      if( row == blockRows && !dual )
+        {
+        accumulateTransposed(p, p, row, jacobian, p, jacobian, p, system, p);
+
+        accumulateTransposed(p, 1, row, jacobian, p, residual, 1, gradient, 1);
+
+        row = 0;
+        }
+      }
+    }
+
+  if( dual )
+    {
+    multiplySelfTransposed(order, p, jacobian, p, system, order);
+    }
+  else if( row > 0 )
+    {
+    accumulateTransposed(p, p, row, jacobian, p, jacobian, p, system, p);
+
+    accumulateTransposed(p, 1, row, jacobian, p, residual, 1, gradient, 1);
+    }
+
+  return loss;
+  }
+
+
+/**
+ * Fire the Network on every Sample, returning the loss and setting sse.
+ */
+
+double LevenbergMarquardt::computeLoss(double& sse)
+  {
+  double loss = 0;
+  sse = 0;
+
+  for( std::vector<Sample*>::const_iterator sample = samples.begin();
+       sample != samples.end();
+       sample++
+     )
+    {
+    network.fire(**sample);
+
+    sse += network.computeError(**sample);
+
+    loss += network.computeLoss(**sample);
+    }
+
+  return loss;
+  }
+
+
+/**
+ * Take one step, raising mu until one lowers the loss.  Returns false,
+ * leaving the weights as they were, if mu exceeds its maximum first.
+ * Sets sse to the summed error at the weights left in the Network.
+ */
+
+bool LevenbergMarquardt::iterate(double& sse)
+  {
+  int p = parameterCount;
+
+  double loss = formSystem(sse);
+
+  network.getWeights(weights);
+
+  if( mu < muMin )
+    {
+    mu = muMin;
+    }
+
+  for( ; mu <= muMax; mu *= 10 )
+    {
+    for( int k = 0; k < order*order; k++ )
+      {
+      factor[k] = system[k];
+      }
+
+    for( int i = 0; i < order; i++ )
+      {
+      factor[i*order + i] += mu;
+      }
+
+    if( !choleskyFactor(order, factor, order) )
+      {
+      continue;
+      }
+
+    if( dual )
+      {
+      // solve (J J^T + mu I) z = e, and the step is -J^T z
+
+      for( int i = 0; i < order; i++ )
+        {
+        rhs[i] = residual[i];
+        }
+
+      choleskySolve(order, factor, order, rhs);
+
+      for( int j = 0; j < p; j++ )
+        {
+        step[j] = 0;
+        }
+
+      accumulateTransposed(p, 1, order, jacobian, p, rhs, 1, step, 1);
+
+      for( int j = 0; j < p; j++ )
+        {
+        step[j] = weights[j] - step[j];
+        }
+      }
+    else
+      {
+      // solve (J^T J + mu I) d = -J^T e
+
+      for( int j = 0; j < p; j++ )
+        {
+        rhs[j] = -gradient[j];
+        }
+
+      choleskySolve(order, factor, order, rhs);
+
+      for( int j = 0; j < p; j++ )
+        {
+        step[j] = weights[j] + rhs[j];
+        }
+      }
+
+    network.setWeights(step);
+
+    double trialSse;
+
+    if( computeLoss(trialSse) < loss )
+      {
+      mu = mu/10 > muMin ? mu/10 : muMin;
+      sse = trialSse;
+      return true;
+      }
+    }
+
+  network.setWeights(weights);
+
+  return false;
+  }
+
+
+double LevenbergMarquardt::getMu() const
+  {
+  return mu;
+  }
+
+
+/**
+ * destructor
+ */
+
+LevenbergMarquardt::~LevenbergMarquardt()
+  {
+  delete [] jacobian;
+  delete [] residual;
+  delete [] system;
+  delete [] factor;
+  delete [] rhs;
+  delete [] gradient;
+  delete [] weights;
+  delete [] step;
+  }
@@ -0,0 +1,155 @@
+// file:    LevenbergMarquardt.h
+// purpose: Header file for LevenbergMarquardt class
+
+#ifndef __LevenbergMarquardt__
+#define __LevenbergMarquardt__
+
+#include <vector>
+
+#include "Network.h"
+#include "Sample.h"
+
+const double defaultMu             = 0.001;
+
+const double defaultLmMemoryLimit  = 1024;	// megabytes
+
+/**
+ * LevenbergMarquardt takes damped Gauss-Newton steps on the sum of the
+ * squared residuals of a Network over a set of Samples.
+ *
+ * With J the Jacobian of the residuals e with respect to the weights, the
+ * step d solves (J^T J + mu I) d = -J^T e.  The damping mu is divided by 10
+ * after a step that lowers the loss, but not below a floor, and multiplied
+ * by 10 after one that does not, which is then retried.
+ *
+ * With P weights and R residuals, J^T J is P x P.  When R < P the same step
+ * is d = -J^T (J J^T + mu I)^-1 e, which only needs an R x R system, so the
+ * smaller of the two is formed and factored by Cholesky.  In the P x P case
+ * J is formed a block of rows at a time and never stored whole.
+ */
+
+class LevenbergMarquardt
+{
+private:
+
+Network& network;
+
+const std::vector<Sample*>& samples;
+
+/**
+ * the damping, the floor that keeps it from underflowing to 0 (from which
+ * multiplying by 10 could never raise it), and the value above which no
+ * step is worth taking
+ */
+
+double mu;
+
+double muMin;
+
+double muMax;
+
+/**
+ * the number of weights and of residuals (per Sample times Samples)
+ */
+
+int parameterCount;
+
+int residualCount;
+
+/**
+ * whether the R x R system is solved instead of the P x P one
+ */
+
+bool dual;
+
+/**
+ * the order of the system, and the rows of J held at once
+ */
+
+int order;
+
+int blockRows;
+
+/**
+ * J (blockRows x P) and the residuals of its rows
+ */
+
+double* jacobian;
+
+double* residual;
+
+/**
+ * the undamped system and its damped Cholesky factor (order x order),
+ * and the right hand side, which is overwritten by the solution
+ */
+
+double* system;
+
+double* factor;
+
+double* rhs;
+
+/**
+ * J^T e, in the P x P case, the current weights and the step
+ */
+
+double* gradient;
+
+double* weights;
+
+double* step;
+
+
+/**
+ * Fire the Network on every Sample at the current weights and form the
+ * system and right hand side.  Returns the loss, and sets sse to the
+ * summed error.
+ */
+
+double formSystem(double& sse);
+
+
+/**
+ * Fire the Network on every Sample, returning the loss and setting sse.
+ */
+
+double computeLoss(double& sse);
+
+public:
+
+/**
+ * constructor, for a Network and the Samples it is trained on
+ */
+
+LevenbergMarquardt(Network& _network, const std::vector<Sample*>& _samples, double _mu);
+
+
+/**
+ * Return the memory, in megabytes, needed to train a Network on a number
+ * of Samples.
+ */
+
+static double getMegabytesNeeded(const Network& network, int numberSamples);
+
+
+/**
+ * Take one step, raising mu until one lowers the loss.  Returns false,
+ * leaving the weights as they were, if mu exceeds its maximum first.
+ * Sets sse to the summed error at the weights left in the Network.
+ */
+
+bool iterate(double& sse);
+
+
+double getMu() const;
+
+
+/**
+ * destructor
+ */
+
+~LevenbergMarquardt();
+
+}; // class LevenbergMarquardt
+
+#endif
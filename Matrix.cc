@@ -0,0 +1,320 @@
+// file:    Matrix.cc
+// purpose: C++ code for the dense matrix kernels used by batched training
+
+#include "Matrix.h"
+
+#include <math.h>
+
+
+/**
+ * Compute a tile of up to 4 x 4 elements of C = A * B^T, where a and b point
+ * to the first of its rows of A and of B.  A full tile keeps sixteen sums in
+ * registers, so that each element loaded from A or B is used four times.
+ */
+
+static void multiplyTile(int rows, int cols, int k,
+                         const double* a, int lda,
+                         const double* b, int ldb,
+                         double* c, int ldc)
+  {
+  if( rows == 4 && cols == 4 )
+    {
+    const double* a0 = a;
+    const double* a1 = a0 + lda;
+    const double* a2 = a1 + lda;
+    const double* a3 = a2 + lda;
+
+    const double* b0 = b;
+    const double* b1 = b0 + ldb;
+    const double* b2 = b1 + ldb;
+    const double* b3 = b2 + ldb;
+
+    double s[4][4] = {{0}};
+
+    for( int p = 0; p < k; p++ )
+      {
+      double x0 = a0[p], x1 = a1[p], x2 = a2[p], x3 = a3[p];
+      double y0 = b0[p], y1 = b1[p], y2 = b2[p], y3 = b3[p];
+
+      s[0][0] += x0*y0; s[0][1] += x0*y1; s[0][2] += x0*y2; s[0][3] += x0*y3;
+      s[1][0] += x1*y0; s[1][1] += x1*y1; s[1][2] += x1*y2; s[1][3] += x1*y3;
+      s[2][0] += x2*y0; s[2][1] += x2*y1; s[2][2] += x2*y2; s[2][3] += x2*y3;
+      s[3][0] += x3*y0; s[3][1] += x3*y1; s[3][2] += x3*y2; s[3][3] += x3*y3;
+      }
+
+    for( int r = 0; r < 4; r++ )
+      {
+      for( int q = 0; q < 4; q++ )
+        {
+        c[r*ldc + q] = s[r][q];
+        }
+      }
+
+    return;
+    }
+
+  // a partial tile at the edge, one element at a time
+
+  for( int r = 0; r < rows; r++ )
+    {
+    for( int q = 0; q < cols; q++ )
+      {
+      double sum = 0;
+
+      for( int p = 0; p < k; p++ )
+        {
+        sum += a[r*lda + p]*b[q*ldb + p];
+        }
+
+      c[r*ldc + q] = sum;
+      }
+    }
+  }
+
+
+/**
+ * C = A * B^T, where A is m x k, B is n x k and C is m x n.
+ *
+ * Each element is the dot product of a row of A with a row of B, both of
+ * which are contiguous.  C is computed in 4 x 4 tiles.
+ */
+
+void multiplyTransposed(int m, int n, int k,
+                        const double* a, int lda,
+                        const double* b, int ldb,
+                        double* c, int ldc)
+  {
+  for( int i = 0; i < m; i += 4 )
+    {
+    int rows = m-i < 4 ? m-i : 4;
+
+    for( int j = 0; j < n; j += 4 )
+      {
+      int cols = n-j < 4 ? n-j : 4;
+
+      multiplyTile(rows, cols, k, a + i*lda, lda, b + j*ldb, ldb, c + i*ldc + j, ldc);
+      }
+    }
+  }
+
+
+/**
+ * C = A * B, where A is m x k, B is k x n and C is m x n.
+ *
+ * Rows of B are added into rows of C, four at a time, so the inner loop is
+ * contiguous and each row of C is loaded and stored once for four rows of B.
+ */
+
+void multiply(int m, int n, int k,
+              const double* a, int lda,
+              const double* b, int ldb,
+              double* c, int ldc)
+  {
+  for( int i = 0; i < m; i++ )
+    {
+    double* __restrict cRow = c + i*ldc;
+    const double* aRow = a + i*lda;
+
+    for( int j = 0; j < n; j++ )
+      {
+      cRow[j] = 0;
+      }
+
+    int p = 0;
+
+    for( ; p+4 <= k; p += 4 )
+      {
+      double f0 = aRow[p], f1 = aRow[p+1], f2 = aRow[p+2], f3 = aRow[p+3];
+
+      const double* __restrict b0 = b + p*ldb;
+      const double* __restrict b1 = b0 + ldb;
+      const double* __restrict b2 = b1 + ldb;
+      const double* __restrict b3 = b2 + ldb;
+
+      for( int j = 0; j < n; j++ )
+        {
+        cRow[j] += f0*b0[j] + f1*b1[j] + f2*b2[j] + f3*b3[j];
+        }
+      }
+
+    for( ; p < k; p++ )
+      {
+      double factor = aRow[p];
+      const double* __restrict bRow = b + p*ldb;
+
+      for( int j = 0; j < n; j++ )
+        {
+        cRow[j] += factor*bRow[j];
+        }
+      }
+    }
+  }
+
+
+/**
+ * C += A^T * B, where A is k x m, B is k x n and C is m x n.
+ *
+ * This is a sum of k outer products of a row of A with a row of B.  They
+ * are added four at a time, so each row of C is loaded and stored once for
+ * four rows of B.
+ */
+
+void accumulateTransposed(int m, int n, int k,
+                          const double* a, int lda,
+                          const double* b, int ldb,
+                          double* c, int ldc)
+  {
+  int p = 0;
+
+  for( ; p+4 <= k; p += 4 )
+    {
+    const double* a0 = a + p*lda;
+    const double* a1 = a0 + lda;
+    const double* a2 = a1 + lda;
+    const double* a3 = a2 + lda;
+
+    const double* __restrict b0 = b + p*ldb;
+    const double* __restrict b1 = b0 + ldb;
+    const double* __restrict b2 = b1 + ldb;
+    const double* __restrict b3 = b2 + ldb;
+
+    for( int i = 0; i < m; i++ )
+      {
+      double f0 = a0[i], f1 = a1[i], f2 = a2[i], f3 = a3[i];
+      double* __restrict cRow = c + i*ldc;
+
+      for( int j = 0; j < n; j++ )
+        {
+        cRow[j] += f0*b0[j] + f1*b1[j] + f2*b2[j] + f3*b3[j];
+        }
+      }
+    }
+
+  for( ; p < k; p++ )
+    {
+    const double* aRow = a + p*lda;
+    const double* __restrict bRow = b + p*ldb;
+
+    for( int i = 0; i < m; i++ )
+      {
+      double factor = aRow[i];
+      double* __restrict cRow = c + i*ldc;
+
+      for( int j = 0; j < n; j++ )
+        {
+        cRow[j] += factor*bRow[j];
+        }
+      }
+    }
+  }
+
+
+/**
+ * C = A * A^T, where A is m x k and C is m x m.  Only the tiles on and
+ * below the diagonal are computed; the upper triangle is then copied from
+ * the lower one.
+ */
+
+void multiplySelfTransposed(int m, int k,
+                            const double* a, int lda,
+                            double* c, int ldc)
+  {
+  for( int i = 0; i < m; i += 4 )
+    {
+    int rows = m-i < 4 ? m-i : 4;
+
+    for( int j = 0; j <= i; j += 4 )
+      {
+      int cols = m-j < 4 ? m-j : 4;
+
+      multiplyTile(rows, cols, k, a + i*lda, lda, a + j*lda, lda, c + i*ldc + j, ldc);
+      }
+    }
+
+  for( int r = 0; r < m; r++ )
+    {
+    for( int q = r+1; q < m; q++ )
+      {
+      c[r*ldc + q] = c[q*ldc + r];
+      }
+    }
+  }
+
+
+/**
+ * Factor a symmetric positive definite n x n matrix A = L * L^T in place,
+ * leaving L in the lower triangle.  Returns false if A is not positive definite.
+ *
+ * Each element of L is a dot product of two rows of L computed so far,
+ * so the inner loop is contiguous.
+ */
+
+bool choleskyFactor(int n, double* a, int lda)
+  {
+  for( int i = 0; i < n; i++ )
+    {
+    double* rowI = a + i*lda;
+
+    for( int j = 0; j <= i; j++ )
+      {
+      const double* rowJ = a + j*lda;
+
+      double sum = rowI[j];
+
+      for( int p = 0; p < j; p++ )
+        {
+        sum -= rowI[p]*rowJ[p];
+        }
+
+      if( j < i )
+        {
+        rowI[j] = sum/rowJ[j];
+        }
+      else if( sum > 0 )
+        {
+        rowI[i] = sqrt(sum);
+        }
+      else
+        {
+        return false;
+        }
+      }
+    }
+
+  return true;
+  }
+
+
+/**
+ * Solve L * L^T x = b in place, where L is the lower triangle left by
+ * choleskyFactor.
+ */
+
+void choleskySolve(int n, const double* l, int lda, double* b)
+  {
+  // forward substitution with L
+
+  for( int i = 0; i < n; i++ )
+    {
+    double sum = b[i];
+
+    for( int p = 0; p < i; p++ )
+      {
+      sum -= l[i*lda + p]*b[p];
+      }
+
+    b[i] = sum/l[i*lda + i];
+    }
+
+  // back substitution with L^T, a column of L at a time
+
+  for( int i = n-1; i >= 0; i-- )
+    {
+    b[i] /= l[i*lda + i];
+
+    for( int p = 0; p < i; p++ )
+      {
+      b[p] -= l[i*lda + p]*b[i];
+      }
+    }
+  }
@@ -0,0 +1,69 @@
+// file:    Matrix.h
+// purpose: Header file for the dense matrix kernels used by batched training
+
+#ifndef __Matrix__
+#define __Matrix__
+
+/**
+ * Matrices are stored row-major as arrays of doubles.  Each one is passed
+ * with its leading dimension (the distance between the starts of two
+ * consecutive rows), so that a kernel can operate on the first columns of a
+ * wider matrix, e.g. a weight matrix without its bias column.
+ */
+
+/**
+ * C = A * B^T, where A is m x k, B is n x k and C is m x n.
+ */
+
+void multiplyTransposed(int m, int n, int k,
+                        const double* a, int lda,
+                        const double* b, int ldb,
+                        double* c, int ldc);
+
+
+/**
+ * C = A * B, where A is m x k, B is k x n and C is m x n.
+ */
+
+void multiply(int m, int n, int k,
+              const double* a, int lda,
+              const double* b, int ldb,
+              double* c, int ldc);
+
+
+/**
+ * C += A^T * B, where A is k x m, B is k x n and C is m x n.
+ */
+
+void accumulateTransposed(int m, int n, int k,
+                          const double* a, int lda,
+                          const double* b, int ldb,
+                          double* c, int ldc);
+
+
+/**
+ * C = A * A^T, where A is m x k and C is m x m.  Only the lower triangle
+ * is computed; it is then copied to the upper one.
+ */
+
+void multiplySelfTransposed(int m, int k,
+                            const double* a, int lda,
+                            double* c, int ldc);
+
+
+/**
+ * Factor a symmetric positive definite n x n matrix A = L * L^T in place,
+ * leaving L in the lower triangle.  Returns false if A is not positive definite.
+ */
+
+bool choleskyFactor(int n, double* a, int lda);
+
+
+/**
+ * Solve L * L^T x = b in place, where L is the lower triangle left by
+ * choleskyFactor.
+ */
+
+void choleskySolve(int n, const double* l, int lda, double* b);
+
+#endif
@@ -0,0 +1,69 @@
+// file:    Momentum.cc
+// purpose: C++ code for Momentum class
+
+#include "Momentum.h"
+
+
+/**
+ * constructor
+ */
+
+Momentum::Momentum(double _momentum, bool _nesterov)
+  {
+  momentum = _momentum;
+  nesterov = _nesterov;
+  }
+
+
+/**
+ * Momentum keeps a velocity per weight.
+ */
+
+int Momentum::getStateSize() const
+  {
+  return 1;		// velocity
+  }
+
+
+/**
+ * Nothing is kept per step.
+ */
+
+void Momentum::beginStep()
+  {
+  }
+
+
+/**
+ * Update n weights against the gradient, scaled by scale, keeping the
+ * velocities in the state.
+ */
+
+void Momentum::adjust(int n, double* __restrict weight, const double* __restrict gradient,
+                      double* __restrict velocity, double rate, double scale) const
+  {
+  for( int j = 0; j < n; j++ )
+    {
+    double g = scale*gradient[j];
+    double v = momentum*velocity[j] + g;
+
+    velocity[j] = v;
+    weight[j] -= rate*(nesterov ? g + momentum*v : v);
+    }
+  }
+
+
+std::string Momentum::getName() const
+  {
+  return nesterov ? "nesterov" : "momentum";
+  }
+
+
+/**
+ * Make a fresh copy with the same settings.
+ */
+
+Optimizer* Momentum::clone() const
+  {
+  return new Momentum(momentum, nesterov);
+  }
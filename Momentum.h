@@ -0,0 +1,71 @@
+// file:    Momentum.h
+// purpose: Header file for Momentum class
+
+#ifndef __Momentum__
+#define __Momentum__
+
+#include "Optimizer.h"
+
+/**
+ * Gradient descent with momentum: a velocity accumulates the gradient and
+ * decays by the momentum factor each step.  With Nesterov momentum the
+ * weights move by the gradient plus the decayed new velocity, looking one
+ * step ahead.
+ */
+
+class Momentum : public Optimizer
+{
+private:
+
+/**
+ * the factor by which the velocity decays each step
+ */
+
+double momentum;
+
+bool nesterov;
+
+public:
+
+/**
+ * constructor
+ */
+
+Momentum(double _momentum, bool _nesterov);
+
+
+/**
+ * Momentum keeps a velocity per weight.
+ */
+
+int getStateSize() const;
+
+
+/**
+ * Nothing is kept per step.
+ */
+
+void beginStep();
+
+
+/**
+ * Update n weights against the gradient, scaled by scale, keeping the
+ * velocities in the state.
+ */
+
+void adjust(int n, double* weight, const double* gradient, double* state,
+            double rate, double scale) const;
+
+
+std::string getName() const;
+
+
+/**
+ * Make a fresh copy with the same settings.
+ */
+
+Optimizer* clone() const;
+
+}; // class Momentum
+
+#endif
@@ -4,7 +4,9 @@
 // $Id: Network.cc,v 1.8 2010/09/21 17:40:09 keller Exp keller $
 
 #include "Network.h"
+#include "ConvLayer.h"
 #include "OnehotLayer.h"
+#include "SoftmaxLayer.h"
 #include "assert.h"
 
 #include <iostream>
@@ -15,6 +17,8 @@
 
 Network::Network()
   {
+  numberLayers = 0;
+  layer = NULL;
   }
 
 
@@ -22,7 +26,9 @@ Network::Network()
  * constructor
  */
 
-Network::Network(int numberLayers, int* layerSize, ActivationFunction** type, int inputDimension)
+Network::Network(int numberLayers, int* layerSize, ActivationFunction** type, int inputDimension,
+                 const Random& _random)
+  : random(_random)
   {
   init(numberLayers, layerSize, type, inputDimension);
   }
@@ -53,11 +59,33 @@ void Network::init(int _numberLayers, int* layerSize, ActivationFunction** type,
 
   lastLayer = numberLayers-1;
 
-  layer[0] = new Layer(0, layerSize[0], type[0], _inputDimension);
+  // Only the first layer may be convolutional; its size is its number of
+  // filters, and the next layer takes all of its outputs.
+
+  for( int i = 1; i < numberLayers; i++ )
+    {
+    assert( !isConvolution(type[i]) );
+    }
+
+  if( isConvolution(type[0]) )
+    {
+    layer[0] = new ConvLayer(0, layerSize[0], (Convolution*)type[0], _inputDimension, random);
+    }
+  else
+    {
+    layer[0] = new Layer(0, layerSize[0], type[0], _inputDimension, random);
+    }
+
+  int* numberOfInputs = new int[numberLayers];
+
+  for( int i = 1; i < numberLayers; i++ )
+    {
+    numberOfInputs[i] = (i == 1) ? layer[0]->getSize() : layerSize[i-1];
+    }
 
   for( int i = lastLayer-1; i > 0; i-- )
     {
-    layer[i] = new Layer(i, layerSize[i], type[i], layerSize[i-1]);
+    layer[i] = new Layer(i, layerSize[i], type[i], numberOfInputs[i], random);
     }
 
   if( type[lastLayer]->getName() == "onehot" )
@@ -65,18 +93,54 @@ void Network::init(int _numberLayers, int* layerSize, ActivationFunction** type,
     layer[lastLayer] = new OnehotLayer(lastLayer, 
                                        layerSize[lastLayer], 
                                        type[lastLayer], 
-                                       layerSize[lastLayer-1]);
+                                       numberOfInputs[lastLayer],
+                                       random);
+    }
+  else if( type[lastLayer]->getName() == "softmax" )
+    {
+    layer[lastLayer] = new SoftmaxLayer(lastLayer,
+                                        layerSize[lastLayer],
+                                        type[lastLayer],
+                                        numberOfInputs[lastLayer],
+                                        random);
     }
   else
     {
     layer[lastLayer] = new Layer(lastLayer, 
                                  layerSize[lastLayer], 
                                  type[lastLayer], 
-                                 layerSize[lastLayer-1]);
+                                 numberOfInputs[lastLayer],
+                                 random);
+    }
+
+  delete [] numberOfInputs;
+  }
+
+
+
+/**
+ * Randomize the weights again, by a scheme for each Layer, from input to
+ * output.
+ */
+
+void Network::initWeights(const INIT* schemes)
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->initWeights(schemes[i], random);
     }
   }
 
 
+/**
+ * Get the Network's Random.
+ */
+
+Random& Network::getRandom()
+  {
+  return random;
+  }
+
 
 /**
  * Fire all the Neurons in the Network based on the input Sample.
@@ -107,6 +171,37 @@ void Network::use(const Sample& sample)
   }
 
 
+/**
+ * Get the input dimension of the Network.
+ */
+
+int Network::getInputDimension() const
+  {
+  return inputDimension;
+  }
+
+
+/**
+ * Get the number of Layers, including the output Layer.
+ */
+
+int Network::getNumberLayers() const
+  {
+  return numberLayers;
+  }
+
+
+/**
+ * Get the Layer with the specified index.
+ */
+
+const Layer& Network::getLayer(int i) const
+  {
+  assert( i >= 0 && i < numberLayers );
+  return *(layer[i]);
+  }
+
+
 /**
  * Show the output of the network on the standard output stream.
  */
@@ -165,6 +260,173 @@ int Network::computeUsageError(const Sample& sample)
   }
 
 
+/**
+ * Compute the usage error of the bth sample of a fired Batch, as
+ * computeUsageError does for a single Sample.
+ */
+
+int Network::computeUsageError(const Batch& batch, int b) const
+  {
+  const Sample& sample = batch.getSample(b);
+  const double* outputRow = batch.getOutput(lastLayer) + b*layer[lastLayer]->getSize();
+
+  int n = sample.getOutputDimension();
+  for( int i = 0; i < n; i++ )
+    {
+    if( (sample.getOutput(i) > 0.5) != (layer[lastLayer]->getBatchOutput(outputRow, i) > 0.5) )
+      {
+      return 1;		// disagreement
+      }
+    }
+  return 0;		// no disagreement
+  }
+
+
+/**
+ * Return whether using the Network gives the same outputs as firing it,
+ * so that usage errors can be computed from the outputs of training.
+ */
+
+bool Network::useMatchesFire() const
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    if( !layer[i]->useMatchesFire() )
+      {
+      return false;
+      }
+    }
+  return true;
+  }
+
+
+/**
+ * Compute the loss on a fired Sample, whose gradient is backpropagated
+ * by setSensitivity: the sum of the squared errors of the output neurons.
+ */
+
+double Network::computeLoss(const Sample& sample) const
+  {
+  return layer[lastLayer]->computeLoss(sample);
+  }
+
+
+/**
+ * Return the number of residuals of the output Layer per Sample.
+ */
+
+int Network::getResidualCount() const
+  {
+  return layer[lastLayer]->getSize();
+  }
+
+
+/**
+ * Get the kth residual (desired minus actual output) on a fired Sample.
+ */
+
+double Network::getResidual(const Sample& sample, int k) const
+  {
+  return layer[lastLayer]->getResidual(sample, k);
+  }
+
+
+/**
+ * Store the derivatives of the kth residual on a fired Sample with respect
+ * to all weights, layer by layer, in an array of getParameterCount() values.
+ */
+
+void Network::getJacobianRow(const Sample& sample, int k, double* row)
+  {
+  layer[lastLayer]->setResidualSensitivity(k);
+
+  for( int i = lastLayer-1; i >= 0; i-- )
+    {
+    layer[i]->setSensitivity(*(layer[i+1]));
+    }
+
+  layer[0]->getGradientRow(sample, row);
+  row += layer[0]->getParameterCount();
+
+  for( int i = 1; i <= lastLayer; i++ )
+    {
+    layer[i]->getGradientRow(*(layer[i-1]), row);
+    row += layer[i]->getParameterCount();
+    }
+  }
+
+
+/**
+ * Return the number of weights in the Network, including the biases.
+ */
+
+int Network::getParameterCount() const
+  {
+  int count = 0;
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    count += layer[i]->getParameterCount();
+    }
+  return count;
+  }
+
+
+/**
+ * Copy all weights, layer by layer, into an array of getParameterCount() values.
+ */
+
+void Network::getWeights(double* values) const
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->getWeights(values);
+    values += layer[i]->getParameterCount();
+    }
+  }
+
+
+/**
+ * Set all weights, layer by layer, from an array of getParameterCount() values.
+ */
+
+void Network::setWeights(const double* values)
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->setWeights(values);
+    values += layer[i]->getParameterCount();
+    }
+  }
+
+
+/**
+ * Copy the accumulated gradient, layer by layer, into an array.
+ */
+
+void Network::getGradient(double* values) const
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->getGradient(values);
+    values += layer[i]->getParameterCount();
+    }
+  }
+
+
+/**
+ * Set the accumulated gradient, layer by layer, from an array.
+ */
+
+void Network::setGradient(const double* values)
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->setGradient(values);
+    values += layer[i]->getParameterCount();
+    }
+  }
+
+
 /**
  * Set the sensitivities in the Network based on the values in a given Sample,
  * in preparation for adjusting the weights.
@@ -195,6 +457,32 @@ void Network::setFixedSensitivity(int i, int j, double sensitivity)
     layer[i]->setFixedSensitivity(j, sensitivity);
   }
 
+/**
+ * Multiply all the sensitivities by a factor, after setSensitivity, so
+ * that the Sample's gradient is weighted by it.
+ */
+
+void Network::scaleSensitivity(double factor)
+  {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->scaleSensitivity(factor);
+    }
+  }
+
+/**
+ * Backpropagate through only some negative categories of a onehot output
+ * layer, drawn from the Network's random numbers.
+ */
+
+void Network::setNegativeSamples(int count)
+  {
+  assert( layer[lastLayer]->getType() == "onehot" );
+
+  ((OnehotLayer*)layer[lastLayer])->setNegativeSamples(count, random);
+  }
+
+
 /**
  * Set weight to a specific value
  */
@@ -258,14 +546,219 @@ void Network::installAccumulation()
     }
   }
 
-void Network::adjustByRprop(double etaPlus, double etaMinus)
+/**
+ * Start rprop afresh in every Layer.
+ */
+
+void Network::resetRprop(const Rprop& rprop)
+  {
+  for( int i = lastLayer; i >= 0; i-- )
+    {
+    layer[i]->resetRprop(rprop);
+    }
+  }
+
+
+/**
+ * Apply one rprop step to every Layer, using the accumulated gradient.
+ */
+
+void Network::adjustByRprop(const Rprop& rprop, bool errorIncreased)
+  {
+  for( int i = lastLayer; i >= 0; i-- )
+    {
+    layer[i]->adjustByRprop(rprop, errorIncreased);
+    }
+  }
+
+/**
+ * Allocate and clear the state that an Optimizer keeps in every Layer.
+ */
+
+void Network::initOptimizer(const Optimizer& optimizer)
+  {
+  for( int i = lastLayer; i >= 0; i-- )
+    {
+    layer[i]->initOptimizer(optimizer);
+    }
+  }
+
+
+/**
+ * Take one Optimizer step in every Layer, using the accumulated gradient
+ * scaled by scale.
+ */
+
+void Network::adjustByOptimizer(Optimizer& optimizer, double rate, double scale)
+  {
+  optimizer.beginStep();
+
+  for( int i = lastLayer; i >= 0; i-- )
+    {
+    layer[i]->adjustByOptimizer(optimizer, rate, scale);
+    }
+  }
+
+
+/**
+ * Fire all the Layers on the Samples loaded in a Batch, as matrix products,
+ * leaving the outputs and derivatives in the Batch.
+ */
+
+void Network::fireBatch(Batch& batch) const
+  {
+  int n = batch.getSize();
+
+  layer[0]->fireBatch(batch.getInput(), n, batch.getOutput(0), batch.getDeriv(0));
+
+  for( int i = 1; i < numberLayers; i++ )
+    {
+    layer[i]->fireBatch(batch.getOutput(i-1), n, batch.getOutput(i), batch.getDeriv(i));
+    }
+  }
+
+
+/**
+ * Compute the error of the bth sample of a fired Batch, as computeError does
+ * for a single fired Sample.
+ */
+
+double Network::computeError(const Batch& batch, int b) const
+  {
+  const Sample& sample = batch.getSample(b);
+  const double* outputRow = batch.getOutput(lastLayer) + b*layer[lastLayer]->getSize();
+
+  double sse = 0;
+  int n = sample.getOutputDimension();
+  assert(n > 0);
+  for( int i = 0; i < n; i++ )
+    {
+    double error = sample.getOutput(i) - layer[lastLayer]->getBatchOutput(outputRow, i);
+    sse += error*error;
+    }
+  return sse/n;
+  }
+
+
+/**
+ * Compute the loss of the bth sample of a fired Batch, as computeLoss does
+ * for a single fired Sample.
+ */
+
+double Network::computeLoss(const Batch& batch, int b) const
+  {
+  const double* outputRow = batch.getOutput(lastLayer) + b*layer[lastLayer]->getSize();
+
+  return layer[lastLayer]->computeLoss(batch.getSample(b), outputRow);
+  }
+
+
+/**
+ * Set the sensitivities of all Layers for a fired Batch,
+ * starting with the output layer and working backward.
+ */
+
+void Network::setSensitivityBatch(Batch& batch) const
+  {
+  int n = batch.getSize();
+
+  layer[lastLayer]->setSensitivityBatch(batch.getSamples(), n,
+                                        batch.getOutput(lastLayer), batch.getDeriv(lastLayer),
+                                        batch.getSensitivity(lastLayer));
+
+  for( int i = lastLayer-1; i >= 0; i-- )
+    {
+    layer[i]->setSensitivityBatch(*(layer[i+1]), batch.getSensitivity(i+1), n,
+                                  batch.getDeriv(i), batch.getSensitivity(i));
+    }
+  }
+
+
+/**
+ * Accumulate the gradient of every Layer over a Batch whose sensitivities
+ * have been set.
+ */
+
+void Network::accumulateGradientBatch(const Batch& batch)
+  {
+  int n = batch.getSize();
+
+  for( int i = lastLayer; i > 0; i-- )
+    {
+    layer[i]->accumulateGradientBatch(batch.getOutput(i-1), batch.getSensitivity(i), n);
+    }
+  layer[0]->accumulateGradientBatch(batch.getInput(), batch.getSensitivity(0), n);
+  }
+
+
+/**
+ * Add the gradient over a Batch whose sensitivities have been set into an
+ * array of getParameterCount() values, layer by layer, leaving the
+ * Network unchanged.
+ */
+
+void Network::addGradientBatch(const Batch& batch, double* gradient) const
+  {
+  int n = batch.getSize();
+
+  layer[0]->addGradientBatch(batch.getInput(), batch.getSensitivity(0), n, gradient);
+
+  for( int i = 1; i < numberLayers; i++ )
+    {
+    gradient += layer[i-1]->getParameterCount();
+
+    layer[i]->addGradientBatch(batch.getOutput(i-1), batch.getSensitivity(i), n, gradient);
+    }
+  }
+
+
+/**
+ * Move the weights against the accumulated gradient, scaled by rate,
+ * and clear the accumulation.
+ */
+
+void Network::descendGradient(double rate)
   {
   for( int i = lastLayer; i >= 0; i-- )
     {
-    layer[i]->adjustByRprop(etaPlus, etaMinus);
+    layer[i]->descendGradient(rate);
     }
   }
 
+/**
+ * Save or restore the weights and training state of every Layer.
+ */
+
+void Network::saveState(Checkpoint& checkpoint) const
+  {
+  checkpoint.putInt(inputDimension);
+  checkpoint.putInt(numberLayers);
+
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->saveState(checkpoint);
+    }
+
+  random.saveState(checkpoint);
+  }
+
+void Network::loadState(Checkpoint& checkpoint)
+  {
+  if( checkpoint.getInt() != inputDimension || checkpoint.getInt() != numberLayers )
+    {
+    printf("error, the checkpoint does not match the network\n");
+    exit(1);
+    }
+
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    layer[i]->loadState(checkpoint);
+    }
+
+  random.loadState(checkpoint);
+  }
+
+
 /**
  * Show the weights and sensitivities of all Neurons in the network.
  */
@@ -300,7 +793,7 @@ void Network::saveStats(std::ofstream& weightStream)
   weightStream << numberLayers << std::endl;
   for (int i = 0; i < numberLayers; i++)
   {
-    weightStream << layer[i]->getSize() << std::endl;
+    weightStream << layer[i]->getNumberOfNeurons() << std::endl;	// filters, if convolutional
     weightStream << layer[i]->getType() << std::endl;
   }
 }
@@ -311,4 +804,10 @@ void Network::saveStats(std::ofstream& weightStream)
 
 Network::~Network()
   {
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    delete layer[i];
+    }
+
+  delete [] layer;
   }
@@ -3,8 +3,15 @@
 // modified by: Kim Merrill (5/3/13)
 // purpose: Header file for Network class
 
+#ifndef __Network__
+#define __Network__
+
 #include "ActivationFunction.h"
+#include "Batch.h"
+#include "Checkpoint.h"
 #include "Layer.h"
+#include "Optimizer.h"
+#include "Random.h"
 
 #include <iostream>
 #include <fstream>
@@ -26,6 +33,23 @@ int lastLayer;
 
 Layer** layer;
 
+/**
+ * the Network's own source of random numbers, for its weights and the
+ * order of its training Samples
+ */
+
+Random random;
+
+private:
+
+/**
+ * A Network owns its Layers, so it is not copied.
+ */
+
+Network(const Network&);
+
+Network& operator=(const Network&);
+
 public:
 
 /**
@@ -36,10 +60,12 @@ Network();
 
 
 /**
- * constructor
+ * constructor, drawing the weights, and later the order of training, from
+ * a given Random
  */
 
-Network(int _numberLayers, int* sizes, ActivationFunction** types, int inputDimension);
+Network(int _numberLayers, int* sizes, ActivationFunction** types, int inputDimension,
+        const Random& _random = Random());
 
 
 /**
@@ -55,6 +81,21 @@ Network(int _numberLayers, int* sizes, ActivationFunction** types, int inputDime
 void init(int _numberLayers, int* sizes, ActivationFunction** types, int inputDimension);
 
 
+/**
+ * Randomize the weights again, by a scheme for each Layer, from input to
+ * output.
+ */
+
+void initWeights(const INIT* schemes);
+
+
+/**
+ * Get the Network's Random.
+ */
+
+Random& getRandom();
+
+
 /**
  * Fire all the Neurons in the Network based on the input Sample.
  * starting with the hidden layer and working forward.
@@ -67,6 +108,27 @@ void fire(const Sample& sample);
 void use(const Sample& sample);
 
 
+/**
+ * Get the input dimension of the Network.
+ */
+
+int getInputDimension() const;
+
+
+/**
+ * Get the number of Layers, including the output Layer.
+ */
+
+int getNumberLayers() const;
+
+
+/**
+ * Get the Layer with the specified index.
+ */
+
+const Layer& getLayer(int i) const;
+
+
 /**
  * Get the output value of the network, based on the most recent firing.
  */
@@ -105,6 +167,93 @@ double computeError(const Sample& sample);
 int computeUsageError(const Sample& sample);
 
 
+/**
+ * Compute the usage error of the bth sample of a fired Batch, as
+ * computeUsageError does for a single Sample.
+ */
+
+int computeUsageError(const Batch& batch, int b) const;
+
+
+/**
+ * Return whether using the Network gives the same outputs as firing it,
+ * so that usage errors can be computed from the outputs of training.
+ */
+
+bool useMatchesFire() const;
+
+
+/**
+ * Compute the loss on a fired Sample, whose gradient is backpropagated
+ * by setSensitivity: the sum of the squared errors of the output neurons.
+ *
+ * @param sample the Sample from which the inputs to the network are taken
+ */
+
+double computeLoss(const Sample& sample) const;
+
+
+/**
+ * Return the number of residuals of the output Layer per Sample.
+ */
+
+int getResidualCount() const;
+
+
+/**
+ * Get the kth residual (desired minus actual output) on a fired Sample.
+ */
+
+double getResidual(const Sample& sample, int k) const;
+
+
+/**
+ * Store the derivatives of the kth residual on a fired Sample with respect
+ * to all weights, layer by layer, in an array of getParameterCount() values:
+ * one row of the Jacobian used by Levenberg-Marquardt.
+ *
+ * The residual's derivatives are backpropagated through the sensitivities,
+ * which are left set for that residual.
+ */
+
+void getJacobianRow(const Sample& sample, int k, double* row);
+
+
+/**
+ * Return the number of weights in the Network, including the biases.
+ */
+
+int getParameterCount() const;
+
+
+/**
+ * Copy all weights, layer by layer, into an array of getParameterCount() values.
+ */
+
+void getWeights(double* values) const;
+
+
+/**
+ * Set all weights, layer by layer, from an array of getParameterCount() values.
+ */
+
+void setWeights(const double* values);
+
+
+/**
+ * Copy the accumulated gradient, layer by layer, into an array.
+ */
+
+void getGradient(double* values) const;
+
+
+/**
+ * Set the accumulated gradient, layer by layer, from an array.
+ */
+
+void setGradient(const double* values);
+
+
 /**
  * Set the sensitivities in the Network based on the values in a given Sample,
  * in preparation for adjusting the weights.
@@ -123,6 +272,22 @@ void setSensitivity(const Sample& sample);
  */
 void setFixedSensitivity(int i, int j, double sensitivity);
 
+/**
+ * Multiply all the sensitivities by a factor, after setSensitivity, so
+ * that the Sample's gradient is weighted by it.
+ */
+
+void scaleSensitivity(double factor);
+
+
+/**
+ * Backpropagate each Sample through only its desired category, the one
+ * chosen, and count others drawn at random, if the output layer is onehot
+ * (see OnehotLayer::setNegativeSamples).
+ */
+
+void setNegativeSamples(int count);
+
 /**
  * Set weight to a specific value
  */
@@ -147,7 +312,101 @@ void clearAccumulation();
 
 void installAccumulation();
 
-void adjustByRprop(double etaPlus, double etaMinus);
+/**
+ * Start rprop afresh in every Layer.
+ */
+
+void resetRprop(const Rprop& rprop);
+
+
+/**
+ * Apply one rprop step to every Layer, using the accumulated gradient.
+ *
+ * @param errorIncreased whether the error increased over the last epoch (for iRprop+)
+ */
+
+void adjustByRprop(const Rprop& rprop, bool errorIncreased);
+
+
+/**
+ * Allocate and clear the state that an Optimizer keeps in every Layer.
+ */
+
+void initOptimizer(const Optimizer& optimizer);
+
+
+/**
+ * Take one Optimizer step in every Layer, using the accumulated gradient
+ * scaled by scale.
+ */
+
+void adjustByOptimizer(Optimizer& optimizer, double rate, double scale);
+
+
+/**
+ * Fire all the Layers on the Samples loaded in a Batch, as matrix products,
+ * leaving the outputs and derivatives in the Batch.
+ */
+
+void fireBatch(Batch& batch) const;
+
+
+/**
+ * Compute the error of the bth sample of a fired Batch, as computeError does
+ * for a single fired Sample.
+ */
+
+double computeError(const Batch& batch, int b) const;
+
+
+/**
+ * Compute the loss of the bth sample of a fired Batch, as computeLoss does
+ * for a single fired Sample.
+ */
+
+double computeLoss(const Batch& batch, int b) const;
+
+
+/**
+ * Set the sensitivities of all Layers for a fired Batch.
+ */
+
+void setSensitivityBatch(Batch& batch) const;
+
+
+/**
+ * Accumulate the gradient of every Layer over a Batch whose sensitivities
+ * have been set.
+ */
+
+void accumulateGradientBatch(const Batch& batch);
+
+
+/**
+ * Add the gradient over a Batch whose sensitivities have been set into an
+ * array of getParameterCount() values, layer by layer, leaving the
+ * Network unchanged, so that several threads can do so at once.
+ */
+
+void addGradientBatch(const Batch& batch, double* gradient) const;
+
+
+/**
+ * Move the weights against the accumulated gradient, scaled by rate,
+ * and clear the accumulation.
+ */
+
+void descendGradient(double rate);
+
+
+/**
+ * Save or restore the weights and training state of every Layer, and the
+ * state of the Random.
+ */
+
+void saveState(Checkpoint& checkpoint) const;
+
+void loadState(Checkpoint& checkpoint);
 
 
 /**
@@ -175,3 +434,5 @@ void saveStats(std::ofstream& weightStream);
 ~Network();
 
 };
+
+#endif
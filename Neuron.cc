@@ -23,11 +23,12 @@ Neuron::Neuron()
 
 
 /**
- * Initialize this neuron, set its index and number of inputs
- * and randomizing the weights.
+ * Initialize this neuron, set its index and number of inputs.
+ * Its Layer randomizes the weights.
  */
 
-void Neuron::init(int _layerIndex, int _neuronIndex, ActivationFunction* _type, int _numberOfInputs)
+void Neuron::init(int _layerIndex, int _neuronIndex, ActivationFunction* _type, int _numberOfInputs,
+                  double* _weight, double* _accumulated, double* _oldAccumulated, double* _updateValue)
   {
   neuronIndex = _neuronIndex;
 
@@ -41,19 +42,16 @@ void Neuron::init(int _layerIndex, int _neuronIndex, ActivationFunction* _type,
 
   // weight[numberOfInputs] will be the bias
 
-  assert( weight = new double[numberOfInputs+1] );
+  weight = _weight;
 
-  assert( accumulated = new double[numberOfInputs+1] );
+  accumulated = _accumulated;
 
-  assert( oldAccumulated = new double[numberOfInputs+1] );
+  oldAccumulated = _oldAccumulated;
 
-  assert( updateValue = new double[numberOfInputs+1] );
-
-  // Initialize all weights randomly.
+  updateValue = _updateValue;
 
   for( int j = 0; j <= numberOfInputs; j++ )
     {
-    setWeight(j, (drand48()-0.5));
     updateValue[j] = initialUpdate;
     accumulated[j] = 0;
     oldAccumulated[j] = 0;
@@ -151,69 +149,35 @@ void Neuron::accumulateGradient(const Source& source)
   }
 
 
-void Neuron::clearAccumulation()
-  {
-  for( int j = 0 ; j <= numberOfInputs; j++ )
-    {
-    accumulated[j] = 0;
-    }
-  }
+/**
+ * Store the gradient of this neuron's weights for its current sensitivity
+ * in row, without accumulating it.
+ */
 
-void Neuron::installAccumulation()
+void Neuron::getGradient(const Source& source, double* row) const
   {
-  for( int j = 0 ; j <= numberOfInputs; j++ )
+  for( int j = 0 ; j < numberOfInputs; j++ )
     {
-    weight[j] += accumulated[j];
+    row[j] = sensitivity*source.get(j);
     }
-  }
 
-double max(double x, double y)
-  {
-  return x > y ? x : y;
+  row[numberOfInputs] = sensitivity;
   }
 
-double min(double x, double y)
-  {
-  return x > y ? y : x;
-  }
 
-double sign(double x)
+void Neuron::clearAccumulation()
   {
-  return x > 0 ? 1 : x < 0 ? -1 : 0;
+  for( int j = 0 ; j <= numberOfInputs; j++ )
+    {
+    accumulated[j] = 0;
+    }
   }
 
-void Neuron::adjustByRprop(double etaPlus, double etaMinus)
+void Neuron::installAccumulation()
   {
-  double deltaMax = 50;
-  double deltaMin = 1e-6;
-
   for( int j = 0 ; j <= numberOfInputs; j++ )
     {
-    double product = oldAccumulated[j]*accumulated[j];
-
-    if( product > 0 )
-      {
-      updateValue[j] = min(etaPlus*updateValue[j], deltaMax);
-
-      weight[j] -= updateValue[j]*sign(accumulated[j]);
-
-      oldAccumulated[j] = accumulated[j];
-      }
-    else if( product < 0 )
-      {
-      updateValue[j] = max(etaMinus*updateValue[j], deltaMin);
-
-      oldAccumulated[j] = 0;
-
-      // note: no weight change
-      }
-    else
-      {
-      weight[j] -= updateValue[j]*sign(accumulated[j]);
-      oldAccumulated[j] = accumulated[j];
-      }
-
-    accumulated[j] = 0;	// reset
+    weight[j] += accumulated[j];
     }
   }
 
@@ -237,6 +201,16 @@ double Neuron::getWeightedSensitivity(int i) const
   }
 
 
+/**
+ * Get the sensitivity of this neuron.
+ */
+
+double Neuron::getSensitivity() const
+  {
+  return sensitivity;
+  }
+
+
 /**
  * Set a specified weight
  */
@@ -317,13 +291,9 @@ void Neuron::saveWeights(std::ofstream& weightStream)
   }
 
 /**
- * Destructor
+ * Destructor (the weight arrays belong to the Layer)
  */
 
 Neuron::~Neuron()
   {
-  delete [] weight;
-  delete [] accumulated;
-  delete [] updateValue;
-  delete [] oldAccumulated;
   }
@@ -32,7 +32,7 @@ int numberOfInputs;
 
 /**
  * array of weights for this neuron.  The last weight in the array is
- * a bias.
+ * a bias.  The array is one row of the weight matrix owned by the Layer.
  */
 
 double* weight;
@@ -112,11 +112,15 @@ Neuron();
 
 
 /**
- * Initialize this neuron, set its index and number of inputs
- * and randomizing the weights.
+ * Initialize this neuron, set its index and number of inputs.
+ * Its Layer randomizes the weights.
+ *
+ * The weight, accumulated, oldAccumulated and updateValue arrays are rows
+ * (of numberOfInputs+1 values) in the contiguous storage of the Layer.
  */
 
-void init(int _layerIndex, int _neuronIndex, ActivationFunction* _type, int _numberOfInputs);
+void init(int _layerIndex, int _neuronIndex, ActivationFunction* _type, int _numberOfInputs,
+          double* _weight, double* _accumulated, double* _oldAccumulated, double* _updateValue);
 
 
 /**
@@ -158,12 +162,18 @@ void accumulateWeights(const Source& source, double rate);
 
 void accumulateGradient(const Source& source);
 
+
+/**
+ * Store the gradient of this neuron's weights for its current sensitivity
+ * in row, without accumulating it.
+ */
+
+void getGradient(const Source& source, double* row) const;
+
 void clearAccumulation();
 
 void installAccumulation();
 
-void adjustByRprop(double etaPlus, double etaMinus);
-
 
 /**
  * Get the ith weight of this neuron.
@@ -179,6 +189,13 @@ double getWeight(int j) const;
 double getWeightedSensitivity(int j) const;
 
 
+/**
+ * Get the sensitivity of this neuron.
+ */
+
+double getSensitivity() const;
+
+
 /**
  * Set the jth weight of this neuron.
  */
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
 
 #include "OnehotLayer.h"
@@ -18,9 +19,10 @@
  * constructor
  */
 
-OnehotLayer::OnehotLayer(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs) : Layer(_layerIndex, _numberInLayer, _type, _numberOfInputs)
+OnehotLayer::OnehotLayer(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs,
+                         Random& random) : Layer()
   {
-  init(_layerIndex, _numberInLayer, _type, _numberOfInputs);
+  init(_layerIndex, _numberInLayer, _type, _numberOfInputs, random);
   }
 
 
@@ -31,22 +33,109 @@ OnehotLayer::OnehotLayer(int _layerIndex, int _numberInLayer, ActivationFunction
  * Randomize the weights of each Neuron.
  */
 
-void OnehotLayer::init(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs)
+void OnehotLayer::init(int _layerIndex, int _numberInLayer, ActivationFunction* _type, int _numberOfInputs,
+                       Random& random)
   {
-  layerIndex = _layerIndex;
+  ActivationFunction* mytype = new Tansig(); // used to implement one-hot
 
-  numberInLayer = _numberInLayer;
+  Layer::init(_layerIndex, _numberInLayer, mytype, _numberOfInputs, random);	// initialize neurons and weights
 
-  assert( neuron = new Neuron[numberInLayer] );
+  maxIndex = 0;
 
-  ActivationFunction* mytype = new Tansig(); // used to implement one-hot
+  negatives = 0;
+  negativeRandom = NULL;
+  order = chosen = NULL;
+  numberChosen = 0;
+  sparse = false;
+  }
 
-  for( int i = 0; i < numberInLayer; i++ )
+
+/**
+ * Save or restore the Layer's state and the order of the categories, so
+ * that a resumed run draws the same negatives.
+ */
+
+void OnehotLayer::saveState(Checkpoint& checkpoint) const
+  {
+  Layer::saveState(checkpoint);
+
+  checkpoint.putInt(order != NULL);
+
+  if( order )
     {
-    neuron[i].init(layerIndex, i, mytype, _numberOfInputs);	// initialize neuron and weights
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      checkpoint.putInt(order[i]);
+      }
     }
+  }
 
-  maxIndex = 0;
+void OnehotLayer::loadState(Checkpoint& checkpoint)
+  {
+  Layer::loadState(checkpoint);
+
+  bool saved = checkpoint.getInt();
+
+  if( saved && order == NULL )
+    {
+    assert( order = new int[numberInLayer] );
+    }
+
+  // A checkpoint without an order was written before any negatives were
+  // drawn, from the categories in their natural order.
+
+  for( int i = 0; order && i < numberInLayer; i++ )
+    {
+    order[i] = saved ? checkpoint.getInt() : i;
+
+    if( order[i] < 0 || order[i] >= numberInLayer )
+      {
+      printf("error, the checkpoint's order of categories is corrupt\n");
+      exit(1);
+      }
+    }
+  }
+
+
+/**
+ * Backpropagate each Sample through its desired category, the chosen one,
+ * and count negatives drawn at random.
+ */
+
+void OnehotLayer::setNegativeSamples(int count, Random& random)
+  {
+  assert( count >= 0 );
+
+  negatives = count;
+  negativeRandom = &random;
+
+  if( order == NULL )
+    {
+    assert( order = new int[numberInLayer] );
+
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      order[i] = i;
+      }
+    }
+
+  delete [] chosen;
+
+  assert( chosen = new int[count+2] );
+
+  numberChosen = 0;
+  sparse = false;
+  }
+
+
+/**
+ * The layer is saved and reloaded by the name of the one-hot type, rather than
+ * by that of its Tansig neurons.
+ */
+
+std::string OnehotLayer::getType() const
+  {
+  return "onehot";
   }
 
 
@@ -117,12 +206,87 @@ void OnehotLayer::setSensitivity(const Sample& sample)
   assert(desired >= 0);
   assert(desired < numberInLayer);
 
-  for( int i = 0; i < numberInLayer; i++ )
+  if( negatives == 0 || negatives >= numberInLayer - 2 )
     {
-    double value = (i == desired) ? +1 : -1;
-    double error = value - neuron[i].getOutput();
-    neuron[i].setSensitivity(-2 * error);
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      setCategorySensitivity(i, desired, 1);
+      }
+
+    sparse = false;
+    return;
+    }
+
+  // Only the categories chosen for the last Sample need clearing.
+
+  if( sparse )
+    {
+    for( int c = 0; c < numberChosen; c++ )
+      {
+      neuron[chosen[c]].setFixedSensitivity(0);
+      }
+    }
+  else
+    {
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      neuron[i].setFixedSensitivity(0);
+      }
+    }
+
+  sparse = true;
+  numberChosen = 0;
+
+  chosen[numberChosen++] = desired;
+
+  if( maxIndex != desired )
+    {
+    chosen[numberChosen++] = maxIndex;
+    }
+
+  for( int c = 0; c < numberChosen; c++ )
+    {
+    setCategorySensitivity(chosen[c], desired, 1);
     }
+
+  // Draw the negatives by a partial shuffle, passing over the categories
+  // already chosen, and weight each by the negatives it stands for.
+
+  double scale = (double)(numberInLayer - numberChosen)/negatives;
+
+  int drawn = 0;
+
+  for( int t = 0; drawn < negatives; t++ )
+    {
+    int j = t + (int)(negativeRandom->uniform()*(numberInLayer - t));
+
+    int i = order[j];
+    order[j] = order[t];
+    order[t] = i;
+
+    if( i == desired || i == maxIndex )
+      {
+      continue;
+      }
+
+    setCategorySensitivity(i, desired, scale);
+
+    chosen[numberChosen++] = i;
+    drawn++;
+    }
+  }
+
+
+/**
+ * Set the sensitivity of the ith category's Neuron against its +1/-1
+ * target, scaled by a factor.
+ */
+
+void OnehotLayer::setCategorySensitivity(int i, int desired, double scale)
+  {
+  double value = (i == desired) ? +1 : -1;
+  double error = value - neuron[i].getOutput();
+  neuron[i].setSensitivity(-2 * error * scale);
   }
 
 
@@ -140,7 +304,110 @@ double OnehotLayer::computeError(const Sample& sample) const
 
 
 
+/**
+ * Compute the loss on a fired Sample: the squared error of each category's
+ * neuron against +1 for the desired category and -1 for the others.
+ */
+
+double OnehotLayer::computeLoss(const Sample& sample) const
+  {
+  int desired = (int)sample.getOutput(0);
+
+  double sse = 0;
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    double value = (i == desired) ? +1 : -1;
+    double error = value - neuron[i].getOutput();
+    sse += error*error;
+    }
+  return sse;
+  }
+
+
+/**
+ * Compute the loss from a row of a batch output matrix, against the
+ * +1/-1 targets as for a single Sample.
+ */
+
+double OnehotLayer::computeLoss(const Sample& sample, const double* outputRow) const
+  {
+  int desired = (int)sample.getOutput(0);
+
+  double sse = 0;
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    double value = (i == desired) ? +1 : -1;
+    double error = value - outputRow[i];
+    sse += error*error;
+    }
+  return sse;
+  }
+
+
+/**
+ * Get the ith residual against the +1/-1 target of the desired category.
+ */
+
+double OnehotLayer::getResidual(const Sample& sample, int i) const
+  {
+  double value = (i == (int)sample.getOutput(0)) ? +1 : -1;
+  return value - neuron[i].getOutput();
+  }
+
+
+/**
+ * Get the output value from one row of a batch output matrix,
+ * which is the index of the category with the largest output.
+ */
+
+double OnehotLayer::getBatchOutput(const double* outputRow, int i) const
+  {
+  assert(i == 0);
+
+  int maxRow = 0;
+
+  for( int k = 1; k < numberInLayer; k++ )
+    {
+    if( outputRow[k] > outputRow[maxRow] )
+      {
+      maxRow = k;
+      }
+    }
+
+  return maxRow;
+  }
+
+
+/**
+ * Set the sensitivities of the output layer for a batch, based on the Samples.
+ */
+
+void OnehotLayer::setSensitivityBatch(const Sample* const* samples, int batchSize,
+                                      const double* output, const double* deriv,
+                                      double* sensitivity) const
+  {
+  for( int b = 0; b < batchSize; b++ )
+    {
+    int desired = (int)samples[b]->getOutput(0);
+
+    assert(desired >= 0);
+    assert(desired < numberInLayer);
+
+    int row = b*numberInLayer;
+
+    for( int i = 0; i < numberInLayer; i++ )
+      {
+      double value = (i == desired) ? +1 : -1;
+      double error = value - output[row + i];
+      sensitivity[row + i] = -2 * error * deriv[row + i];
+      }
+    }
+  }
+
+
+
 OnehotLayer::~OnehotLayer()
   {
-  delete [] neuron;
+  delete [] order;
+  delete [] chosen;
   }
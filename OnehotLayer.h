@@ -10,6 +10,9 @@
 
 /**
  * A OnehotLayer is a layer of Neurons
+ *
+ * With many categories, a sample can be backpropagated through only some
+ * of them (see setNegativeSamples).
  */
 
 class OnehotLayer : public Layer
@@ -18,6 +21,37 @@ private:
 
 int maxIndex;
 
+/**
+ * the number of negative categories sampled for each Sample, 0 for all of
+ * them, and the Random numbers that choose them
+ */
+
+int negatives;
+
+Random* negativeRandom;
+
+/**
+ * the categories in the order of a partial shuffle, from which the
+ * negatives are drawn, and the categories whose sensitivities were set for
+ * the last Sample, the others being 0 if sparse
+ */
+
+int* order;
+
+int* chosen;
+
+int numberChosen;
+
+bool sparse;
+
+
+/**
+ * Set the sensitivity of the ith category's Neuron against its +1/-1
+ * target, scaled by a factor.
+ */
+
+void setCategorySensitivity(int i, int desired, double scale);
+
 
 public:
 
@@ -25,7 +59,8 @@ public:
  * constructor
  */
 
-OnehotLayer(int _layerIndex, int _numberInOnehotLayer, ActivationFunction* type, int _numberInputs);
+OnehotLayer(int _layerIndex, int _numberInOnehotLayer, ActivationFunction* type, int _numberInputs,
+            Random& random);
 
 
 /**
@@ -35,7 +70,11 @@ OnehotLayer(int _layerIndex, int _numberInOnehotLayer, ActivationFunction* type,
  * Randomize the weights of each Neuron.
  */
 
-void init(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs);
+void init(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs,
+          Random& random);
+
+
+std::string getType() const;
 
 
 /**
@@ -72,30 +111,62 @@ Neuron& operator[](int index);
 
 
 /**
- * Adjust the weights on each neuron in this layer.
+ * Show the weights on each neuron in this layer on the standard output stream.
  */
 
-void adjustWeights(const Source& source, double rate);
+void showWeights(const char* title) const;
 
 
 /**
- * Show the weights on each neuron in this layer on the standard output stream.
+ * Show the output on the standard output stream.
  */
 
-void showWeights(const char* title) const;
+void showOutput() const;
 
 
 /**
- * Show the output on the standard output stream.
+ * Backpropagate each Sample through only its desired category, the
+ * category the layer chose (if another), and count of the other categories,
+ * the negatives, drawn at random without replacement.  The sampled
+ * negatives' sensitivities are scaled by the number of negatives over
+ * count, so that the expected gradient is the full one; the others are 0,
+ * and the Layer skips their Neurons.  A count of 0 backpropagates through
+ * every category.
+ *
+ * Only setSensitivity(sample) samples; the batch path still uses all the
+ * categories.
  */
 
-void showOutput() const;
+void setNegativeSamples(int count, Random& random);
+
+
+/**
+ * Save or restore the Layer's state, and with it the order of the
+ * categories, which the next negatives are drawn from.
+ */
+
+void saveState(Checkpoint& checkpoint) const;
+
+void loadState(Checkpoint& checkpoint);
 
 
 void setSensitivity(const Sample& sample);
 
 double computeError(const Sample& sample) const;
 
+double computeLoss(const Sample& sample) const;
+
+double computeLoss(const Sample& sample, const double* outputRow) const;
+
+double getResidual(const Sample& sample, int i) const;
+
+
+double getBatchOutput(const double* outputRow, int i) const;
+
+void setSensitivityBatch(const Sample* const* samples, int batchSize,
+                         const double* output, const double* deriv,
+                         double* sensitivity) const;
+
 
 /**
  * Destructor
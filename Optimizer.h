@@ -0,0 +1,65 @@
+// file:    Optimizer.h
+// purpose: Header file for the Optimizer interface
+
+#ifndef __Optimizer__
+#define __Optimizer__
+
+#include <string>
+
+#include "Checkpoint.h"
+
+/**
+ * An Optimizer turns an accumulated gradient into a weight update, for
+ * on-line and mini-batch training.  It works on the contiguous arrays of a
+ * Layer, and keeps whatever it remembers between steps (velocities, moment
+ * estimates) in a state array that the Layer allocates next to its weights,
+ * getStateSize() values per weight.
+ */
+
+class Optimizer
+{
+public:
+
+/**
+ * the number of state values kept per weight
+ */
+
+virtual int getStateSize() const = 0;
+
+/**
+ * Begin a step of the whole network, before adjust is called for each Layer.
+ */
+
+virtual void beginStep() = 0;
+
+/**
+ * Update n weights against the gradient, scaled by scale, using the given
+ * learning rate.  The state holds getStateSize() arrays of n values, one
+ * after the other.
+ */
+
+virtual void adjust(int n, double* weight, const double* gradient, double* state,
+                    double rate, double scale) const = 0;
+
+virtual std::string getName() const = 0;
+
+/**
+ * Save or restore what the Optimizer itself remembers between steps
+ * (not the per-weight state, which the Layers save).
+ */
+
+virtual void saveState(Checkpoint& checkpoint) const {}
+
+virtual void loadState(Checkpoint& checkpoint) {}
+
+/**
+ * Make a fresh copy with the same settings, so each Trainer has its own.
+ */
+
+virtual Optimizer* clone() const = 0;
+
+virtual ~Optimizer() {}
+
+};
+
+#endif
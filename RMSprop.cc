@@ -0,0 +1,70 @@
+// file:    RMSprop.cc
+// purpose: C++ code for RMSprop class
+
+#include "RMSprop.h"
+#include <math.h>
+
+
+/**
+ * constructor
+ */
+
+RMSprop::RMSprop(double _rho, double _epsilon)
+  {
+  rho = _rho;
+  epsilon = _epsilon;
+  }
+
+
+/**
+ * RMSprop keeps a mean square of the gradient per weight.
+ */
+
+int RMSprop::getStateSize() const
+  {
+  return 1;		// mean square of the gradient
+  }
+
+
+/**
+ * Nothing is kept per step.
+ */
+
+void RMSprop::beginStep()
+  {
+  }
+
+
+/**
+ * Update n weights against the gradient, scaled by scale, keeping the mean
+ * squares in the state.
+ */
+
+void RMSprop::adjust(int n, double* __restrict weight, const double* __restrict gradient,
+                     double* __restrict meanSquare, double rate, double scale) const
+  {
+  for( int j = 0; j < n; j++ )
+    {
+    double g = scale*gradient[j];
+    double s = rho*meanSquare[j] + (1-rho)*g*g;
+
+    meanSquare[j] = s;
+    weight[j] -= rate*g/(sqrt(s) + epsilon);
+    }
+  }
+
+
+std::string RMSprop::getName() const
+  {
+  return "rmsprop";
+  }
+
+
+/**
+ * Make a fresh copy with the same settings.
+ */
+
+Optimizer* RMSprop::clone() const
+  {
+  return new RMSprop(rho, epsilon);
+  }
@@ -0,0 +1,73 @@
+// file:    RMSprop.h
+// purpose: Header file for RMSprop class
+
+#ifndef __RMSprop__
+#define __RMSprop__
+
+#include "Optimizer.h"
+
+/**
+ * RMSprop: steps are the gradient divided by the square root of a decaying
+ * average of its square.
+ */
+
+class RMSprop : public Optimizer
+{
+private:
+
+/**
+ * the decay rate of the average
+ */
+
+double rho;
+
+/**
+ * added to the root of the average, so that no step divides by 0
+ */
+
+double epsilon;
+
+public:
+
+/**
+ * constructor
+ */
+
+RMSprop(double _rho, double _epsilon);
+
+
+/**
+ * RMSprop keeps a mean square of the gradient per weight.
+ */
+
+int getStateSize() const;
+
+
+/**
+ * Nothing is kept per step.
+ */
+
+void beginStep();
+
+
+/**
+ * Update n weights against the gradient, scaled by scale, keeping the mean
+ * squares in the state.
+ */
+
+void adjust(int n, double* weight, const double* gradient, double* state,
+            double rate, double scale) const;
+
+
+std::string getName() const;
+
+
+/**
+ * Make a fresh copy with the same settings.
+ */
+
+Optimizer* clone() const;
+
+}; // class RMSprop
+
+#endif
@@ -0,0 +1,145 @@
+// file:    Random.cc
+// purpose: C++ code for Random class
+
+#include "Random.h"
+
+#include <math.h>
+
+
+static inline uint64_t rotate(uint64_t x, int k)
+  {
+  return (x << k) | (x >> (64 - k));
+  }
+
+
+/**
+ * constructor, for a stream of a seed
+ */
+
+Random::Random(uint64_t seed, int stream)
+  {
+  this->seed(seed, stream);
+  }
+
+
+/**
+ * Start again at the beginning of a stream of a seed.
+ *
+ * splitmix64 turns the seed into the four words of the state, so that
+ * nearby seeds give unrelated states, and the state is never all zero.
+ */
+
+void Random::seed(uint64_t seed, int stream)
+  {
+  uint64_t x = seed;
+
+  for( int i = 0; i < 4; i++ )
+    {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    state[i] = z ^ (z >> 31);
+    }
+
+  for( int k = 0; k < stream; k++ )
+    {
+    jump();
+    }
+  }
+
+
+/**
+ * Return the next 64 random bits.
+ */
+
+uint64_t Random::next()
+  {
+  uint64_t result = rotate(state[1]*5, 7)*9;
+
+  uint64_t t = state[1] << 17;
+
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+
+  state[2] ^= t;
+
+  state[3] = rotate(state[3], 45);
+
+  return result;
+  }
+
+
+/**
+ * Return a random number uniformly distributed in [0, 1), from the top
+ * 53 bits.
+ */
+
+double Random::uniform()
+  {
+  return (next() >> 11) * (1.0/9007199254740992.0);
+  }
+
+
+/**
+ * Return a random number normally distributed with mean 0 and variance 1,
+ * by the Box-Muller transform of two uniform ones.
+ */
+
+double Random::normal()
+  {
+  double u = 1 - uniform();	// in (0, 1]
+  double v = uniform();
+
+  return sqrt(-2*log(u))*cos(2*M_PI*v);
+  }
+
+
+/**
+ * Advance by 2^128 numbers, to the start of the next stream.
+ */
+
+void Random::jump()
+  {
+  static const uint64_t polynomial[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                         0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+
+  uint64_t s[4] = {0, 0, 0, 0};
+
+  for( int i = 0; i < 4; i++ )
+    {
+    for( int b = 0; b < 64; b++ )
+      {
+      if( polynomial[i] & ((uint64_t)1 << b) )
+        {
+        for( int k = 0; k < 4; k++ )
+          {
+          s[k] ^= state[k];
+          }
+        }
+
+      next();
+      }
+    }
+
+  for( int k = 0; k < 4; k++ )
+    {
+    state[k] = s[k];
+    }
+  }
+
+
+/**
+ * Save or restore the state.
+ */
+
+void Random::saveState(Checkpoint& checkpoint) const
+  {
+  checkpoint.putLongs(state, 4);
+  }
+
+void Random::loadState(Checkpoint& checkpoint)
+  {
+  checkpoint.getLongs(state, 4);
+  }
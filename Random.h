@@ -0,0 +1,82 @@
+// file:    Random.h
+// purpose: Header file for Random class
+
+#ifndef __Random__
+#define __Random__
+
+#include <stdint.h>
+
+#include "Checkpoint.h"
+
+const uint64_t defaultSeed = 1;
+
+/**
+ * A Random generates pseudo-random numbers with xoshiro256** (Blackman and
+ * Vigna), from a 256-bit state filled from a seed by splitmix64.
+ *
+ * Each Random has its own state, so generators used by different threads
+ * do not interfere.  One seed gives many streams: stream k starts 2^128
+ * numbers after stream k-1, so they never overlap.
+ */
+
+class Random
+{
+private:
+
+uint64_t state[4];
+
+public:
+
+/**
+ * constructor, for a stream of a seed
+ */
+
+Random(uint64_t seed = defaultSeed, int stream = 0);
+
+
+/**
+ * Start again at the beginning of a stream of a seed.
+ */
+
+void seed(uint64_t seed, int stream = 0);
+
+
+/**
+ * Return the next 64 random bits.
+ */
+
+uint64_t next();
+
+
+/**
+ * Return a random number uniformly distributed in [0, 1).
+ */
+
+double uniform();
+
+
+/**
+ * Return a random number normally distributed with mean 0 and variance 1.
+ */
+
+double normal();
+
+
+/**
+ * Advance by 2^128 numbers, to the start of the next stream.
+ */
+
+void jump();
+
+
+/**
+ * Save or restore the state.
+ */
+
+void saveState(Checkpoint& checkpoint) const;
+
+void loadState(Checkpoint& checkpoint);
+
+}; // class Random
+
+#endif
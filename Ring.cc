@@ -0,0 +1,290 @@
+// file:    Ring.cc
+// purpose: C++ code for Ring class
+
+#include "Ring.h"
+#include "helper.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+static std::string workerPath(const char* path, int rank)
+  {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%d", rank);
+  return std::string(path) + suffix;
+  }
+
+
+static void makeAddress(const std::string& path, struct sockaddr_un& address)
+  {
+  if( path.size() >= sizeof(address.sun_path) )
+    {
+    printf("error, socket path %s is too long\n", path.c_str());
+    exit(1);
+    }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path.c_str());
+  }
+
+
+/**
+ * constructor, for worker rank of size, connecting to the others
+ */
+
+Ring::Ring(const char* path, int _rank, int _size)
+  {
+  rank = _rank;
+  size = _size;
+  next = previous = -1;
+
+  if( size == 1 )
+    {
+    return;		// nothing to connect
+    }
+
+  // Listen for the previous worker.
+
+  std::string listenPath = workerPath(path, rank);
+
+  struct sockaddr_un address;
+
+  makeAddress(listenPath, address);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  unlink(listenPath.c_str());
+
+  if( listener < 0
+   || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0
+   || listen(listener, 1) != 0 )
+    {
+    printf("error, worker %d cannot listen on %s: %s\n", rank, listenPath.c_str(), strerror(errno));
+    exit(1);
+    }
+
+  // Connect to the next worker, which may not have started yet.
+
+  std::string nextPath = workerPath(path, (rank+1)%size);
+
+  makeAddress(nextPath, address);
+
+  double start = getTime();
+
+  for( ;; )
+    {
+    next = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if( next >= 0 && connect(next, (struct sockaddr*)&address, sizeof(address)) == 0 )
+      {
+      break;
+      }
+
+    if( next >= 0 )
+      {
+      close(next);
+      }
+
+    if( getTime() - start > ringConnectTimeout )
+      {
+      printf("error, worker %d cannot connect to %s\n", rank, nextPath.c_str());
+      exit(1);
+      }
+
+    usleep(10000);
+    }
+
+  // Wait as long for the previous worker to connect.
+
+  struct pollfd wait;
+
+  wait.fd = listener;
+  wait.events = POLLIN;
+
+  int ready;
+
+  do
+    {
+    ready = poll(&wait, 1, (int)(ringConnectTimeout*1000));
+    }
+  while( ready < 0 && errno == EINTR );
+
+  if( ready == 0 )
+    {
+    printf("error, worker %d cannot accept a connection: timed out\n", rank);
+    exit(1);
+    }
+
+  previous = ready > 0 ? accept(listener, NULL, NULL) : -1;
+
+  if( previous < 0 )
+    {
+    printf("error, worker %d cannot accept a connection: %s\n", rank, strerror(errno));
+    exit(1);
+    }
+
+  close(listener);
+
+  unlink(listenPath.c_str());
+
+  // Sending and receiving at once, neither blocks the other.
+
+  fcntl(next, F_SETFL, fcntl(next, F_GETFL) | O_NONBLOCK);
+  fcntl(previous, F_SETFL, fcntl(previous, F_GETFL) | O_NONBLOCK);
+  }
+
+
+/**
+ * Send one array to the next worker while receiving one from the previous.
+ */
+
+void Ring::exchange(const double* out, int outCount, double* in, int inCount)
+  {
+  const char* outBytes = (const char*)out;
+  char* inBytes = (char*)in;
+
+  size_t outSize = outCount*sizeof(double);
+  size_t inSize = inCount*sizeof(double);
+
+  size_t sent = 0;
+  size_t received = 0;
+
+  while( sent < outSize || received < inSize )
+    {
+    struct pollfd wait[2];
+
+    wait[0].fd = next;
+    wait[0].events = sent < outSize ? POLLOUT : 0;
+    wait[1].fd = previous;
+    wait[1].events = received < inSize ? POLLIN : 0;
+
+    if( poll(wait, 2, -1) < 0 )
+      {
+      if( errno == EINTR )
+        {
+        continue;
+        }
+
+      printf("error, worker %d cannot poll its sockets: %s\n", rank, strerror(errno));
+      exit(1);
+      }
+
+    if( sent < outSize && wait[0].revents )
+      {
+      ssize_t count = send(next, outBytes + sent, outSize - sent, MSG_NOSIGNAL);
+
+      if( count < 0 && errno != EAGAIN && errno != EINTR )
+        {
+        printf("error, worker %d lost the next worker: %s\n", rank, strerror(errno));
+        exit(1);
+        }
+
+      sent += count > 0 ? count : 0;
+      }
+
+    if( received < inSize && wait[1].revents )
+      {
+      ssize_t count = recv(previous, inBytes + received, inSize - received, 0);
+
+      if( count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR) )
+        {
+        printf("error, worker %d lost the previous worker\n", rank);
+        exit(1);
+        }
+
+      received += count > 0 ? count : 0;
+      }
+    }
+  }
+
+
+/**
+ * Replace an array of n values, the same length in every worker, by
+ * the sum of the arrays of all the workers.
+ *
+ * Chunk c is values[c*n/size] up to values[(c+1)*n/size].  In the first
+ * size-1 steps, each worker passes on the chunk it last added to and adds
+ * in the one it receives, so that worker r ends with the whole sum of
+ * chunk r+1.  In the next size-1 steps the whole sums are passed round.
+ */
+
+void Ring::allReduce(double* values, int n)
+  {
+  if( size == 1 )
+    {
+    return;
+    }
+
+  std::vector<int> start(size+1);
+
+  for( int c = 0; c <= size; c++ )
+    {
+    start[c] = (int)((long)c*n/size);
+    }
+
+  buffer.resize(n/size + 1);
+
+  for( int step = 0; step < size-1; step++ )
+    {
+    int out = (rank - step + size)%size;
+    int in = (rank - step - 1 + size)%size;
+
+    exchange(values + start[out], start[out+1] - start[out], &buffer[0], start[in+1] - start[in]);
+
+    for( int k = start[in]; k < start[in+1]; k++ )
+      {
+      values[k] += buffer[k - start[in]];
+      }
+    }
+
+  for( int step = 0; step < size-1; step++ )
+    {
+    int out = (rank + 1 - step + size)%size;
+    int in = (rank - step + size)%size;
+
+    exchange(values + start[out], start[out+1] - start[out],
+             values + start[in], start[in+1] - start[in]);
+    }
+  }
+
+
+/**
+ * Get this worker's rank, from 0, and the number of workers.
+ */
+
+int Ring::getRank() const
+  {
+  return rank;
+  }
+
+int Ring::getSize() const
+  {
+  return size;
+  }
+
+
+/**
+ * destructor, closing the sockets
+ */
+
+Ring::~Ring()
+  {
+  if( next >= 0 )
+    {
+    close(next);
+    }
+
+  if( previous >= 0 )
+    {
+    close(previous);
+    }
+  }
@@ -0,0 +1,94 @@
+// file:    Ring.h
+// purpose: Header file for Ring class
+
+#ifndef __Ring__
+#define __Ring__
+
+#include <string>
+#include <vector>
+
+/**
+ * the seconds a worker waits for the next one in the Ring to start
+ */
+
+const double  ringConnectTimeout         = 60;
+
+/**
+ * A Ring connects a number of worker processes in a ring, each to the next
+ * by a Unix-domain socket, so that they can sum arrays of values: each
+ * worker gives its own array and gets back the sum of all of them.
+ *
+ * Worker r listens on <path>.r and connects to worker r+1 (the last to
+ * worker 0), so the workers may be started in any order.  The socket
+ * file is removed once the previous worker has connected.
+ *
+ * The sum is a ring all-reduce: the array is cut into as many chunks as
+ * there are workers, each chunk is summed as it passes once round the
+ * ring, and the sums are then passed round once more.  Each worker sends
+ * and receives about twice the array, however many workers there are, and
+ * every worker gets exactly the same sums.
+ */
+
+class Ring
+{
+private:
+
+int rank;
+
+int size;
+
+/**
+ * the sockets to the next and previous workers
+ */
+
+int next;
+
+int previous;
+
+/**
+ * space for a chunk being received
+ */
+
+std::vector<double> buffer;
+
+/**
+ * Send one array to the next worker while receiving one from the previous.
+ */
+
+void exchange(const double* out, int outCount, double* in, int inCount);
+
+public:
+
+/**
+ * constructor, for worker rank of size, connecting to the others
+ */
+
+Ring(const char* path, int _rank, int _size);
+
+
+/**
+ * Replace an array of n values, the same length in every worker, by
+ * the sum of the arrays of all the workers.
+ */
+
+void allReduce(double* values, int n);
+
+
+/**
+ * Get this worker's rank, from 0, and the number of workers.
+ */
+
+int getRank() const;
+
+int getSize() const;
+
+
+/**
+ * destructor, closing the sockets
+ */
+
+~Ring();
+
+}; // class Ring
+
+#endif
@@ -0,0 +1,136 @@
+// file:    Rprop.cc
+// purpose: C++ code for Rprop class
+
+#include "Rprop.h"
+
+
+/**
+ * constructor, with the usual constants
+ */
+
+Rprop::Rprop()
+  {
+  variant = IRPROP_MINUS;
+  etaPlus = 1.2;
+  etaMinus = 0.5;
+  deltaMax = 50;
+  deltaMin = 1e-6;
+  deltaInit = 0.1;
+  }
+
+
+void Rprop::setVariant(RPROP_VARIANT _variant)
+  {
+  variant = _variant;
+  }
+
+void Rprop::setEtaPlus(double _etaPlus)
+  {
+  etaPlus = _etaPlus;
+  }
+
+void Rprop::setEtaMinus(double _etaMinus)
+  {
+  etaMinus = _etaMinus;
+  }
+
+void Rprop::setDeltaMax(double _deltaMax)
+  {
+  deltaMax = _deltaMax;
+  }
+
+void Rprop::setDeltaMin(double _deltaMin)
+  {
+  deltaMin = _deltaMin;
+  }
+
+void Rprop::setDeltaInit(double _deltaInit)
+  {
+  deltaInit = _deltaInit;
+  }
+
+
+RPROP_VARIANT Rprop::getVariant() const
+  {
+  return variant;
+  }
+
+std::string Rprop::getVariantName() const
+  {
+  return variant == IRPROP_PLUS ? "irprop+" : "irprop-";
+  }
+
+double Rprop::getDeltaInit() const
+  {
+  return deltaInit;
+  }
+
+
+/**
+ * Parse a variant name ("irprop-" or "irprop+"), returning false if unknown.
+ */
+
+bool Rprop::parseVariant(const std::string& name, RPROP_VARIANT& variant)
+  {
+  if( name == "irprop-" )
+    {
+    variant = IRPROP_MINUS;
+    return true;
+    }
+
+  if( name == "irprop+" )
+    {
+    variant = IRPROP_PLUS;
+    return true;
+    }
+
+  return false;
+  }
+
+
+/**
+ * Apply one step to n weights, using and then clearing the gradient.
+ *
+ * The loop body has no branches: every case is computed and the results are
+ * chosen by comparisons, which the compiler turns into SIMD masks and blends.
+ * The arrays never overlap, and saying so lets the loop be vectorized.
+ */
+
+void Rprop::adjust(int n,
+                   double* __restrict weight,
+                   double* __restrict gradient,
+                   double* __restrict oldGradient,
+                   double* __restrict updateValue,
+                   double* __restrict weightChange,
+                   bool errorIncreased) const
+  {
+  // Factor applied to the previous change when undoing it (iRprop+ only).
+
+  double undo = (variant == IRPROP_PLUS && errorIncreased) ? -1 : 0;
+
+  for( int j = 0; j < n; j++ )
+    {
+    double g = gradient[j];
+    double delta = updateValue[j];
+    double product = oldGradient[j]*g;
+
+    double grown = etaPlus*delta < deltaMax ? etaPlus*delta : deltaMax;
+    double shrunk = etaMinus*delta > deltaMin ? etaMinus*delta : deltaMin;
+
+    delta = product > 0 ? grown : delta;
+    delta = product < 0 ? shrunk : delta;
+
+    double direction = g > 0 ? -1.0 : 0.0;
+    direction = g < 0 ? 1.0 : direction;
+
+    // On a sign change the weight stays, or its last change is undone.
+
+    double change = product < 0 ? undo*weightChange[j] : direction*delta;
+
+    weight[j] += change;
+    updateValue[j] = delta;
+    weightChange[j] = product < 0 ? 0.0 : change;
+    oldGradient[j] = product < 0 ? 0.0 : g;
+    gradient[j] = 0;	// reset
+    }
+  }
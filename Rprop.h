@@ -0,0 +1,112 @@
+// file:    Rprop.h
+// purpose: Header file for Rprop class
+
+#ifndef __Rprop__
+#define __Rprop__
+
+#include <string>
+
+/**
+ * The Rprop variants:
+ *
+ * <pre>
+ * <ul>
+ *     <li>iRprop-: when the gradient changes sign, the step size shrinks and
+ *         the weight is left alone for this epoch.
+ *
+ *     <li>iRprop+: as iRprop-, except that if the error increased over the
+ *         epoch, the previous change of the weight is also undone.
+ * </ul>
+ * </pre>
+ */
+
+enum RPROP_VARIANT {IRPROP_MINUS = 0, IRPROP_PLUS = 1};
+
+/**
+ * Rprop holds the constants of resilient backpropagation and applies one
+ * Rprop step to contiguous arrays of weights, gradients, previous gradients,
+ * step sizes and previous weight changes.
+ */
+
+class Rprop
+{
+private:
+
+RPROP_VARIANT variant;
+
+/**
+ * step size growth factor when the gradient keeps its sign
+ */
+
+double etaPlus;
+
+/**
+ * step size shrink factor when the gradient changes sign
+ */
+
+double etaMinus;
+
+double deltaMax;
+
+double deltaMin;
+
+/**
+ * step size with which every weight starts
+ */
+
+double deltaInit;
+
+public:
+
+/**
+ * constructor, with the usual constants
+ */
+
+Rprop();
+
+
+void setVariant(RPROP_VARIANT _variant);
+
+void setEtaPlus(double _etaPlus);
+
+void setEtaMinus(double _etaMinus);
+
+void setDeltaMax(double _deltaMax);
+
+void setDeltaMin(double _deltaMin);
+
+void setDeltaInit(double _deltaInit);
+
+
+RPROP_VARIANT getVariant() const;
+
+std::string getVariantName() const;
+
+double getDeltaInit() const;
+
+
+/**
+ * Parse a variant name ("irprop-" or "irprop+"), returning false if unknown.
+ */
+
+static bool parseVariant(const std::string& name, RPROP_VARIANT& variant);
+
+
+/**
+ * Apply one step to n weights, using and then clearing the gradient.
+ *
+ * @param errorIncreased whether the error increased over the last epoch,
+ *                       used by iRprop+ to decide on undoing weight changes
+ */
+
+void adjust(int n,
+            double* weight,
+            double* gradient,
+            double* oldGradient,
+            double* updateValue,
+            double* weightChange,
+            bool errorIncreased) const;
+
+}; // class Rprop
+
+#endif
@@ -0,0 +1,168 @@
+// file:    SampleFeed.cc
+// purpose: C++ code for SampleFeed class
+
+#include "SampleFeed.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/**
+ * constructor, for the file at a path, which need not exist yet
+ */
+
+SampleFeed::SampleFeed(const char* _path)
+  : path(_path)
+  {
+  offset = 0;
+  haveDimensions = false;
+  outputDimension = inputDimension = 0;
+  }
+
+
+/**
+ * Read the samples appended since the last poll onto the end of a list,
+ * returning how many there were.
+ */
+
+int SampleFeed::poll(std::list<Sample*>& samples)
+  {
+  FILE* file = fopen(path.c_str(), "r");
+
+  if( file == NULL )
+    {
+    return 0;
+    }
+
+  if( fseek(file, offset, SEEK_SET) != 0 )
+    {
+    fclose(file);
+    return 0;
+    }
+
+  char block[65536];
+  size_t count;
+
+  while( (count = fread(block, 1, sizeof(block), file)) > 0 )
+    {
+    partial.append(block, count);
+    offset += count;
+    }
+
+  fclose(file);
+
+  size_t end = partial.rfind('\n');
+
+  if( end == std::string::npos )
+    {
+    return 0;
+    }
+
+  std::string text = partial.substr(0, end+1);
+
+  partial.erase(0, end+1);
+
+  int added = 0;
+
+  const char* next = text.c_str();
+
+  for( ;; )
+    {
+    char* after;
+
+    double value = strtod(next, &after);
+
+    if( after == next )
+      {
+      // not a number: skip any other text up to the next blank
+
+      while( *next == ' ' || *next == '\t' || *next == '\n' || *next == '\r' )
+        {
+        next++;
+        }
+
+      if( *next == '\0' )
+        {
+        break;
+        }
+
+      printf("warning, skipping text in %s: ", path.c_str());
+
+      while( *next && *next != ' ' && *next != '\t' && *next != '\n' && *next != '\r' )
+        {
+        putchar(*next++);
+        }
+
+      printf("\n");
+
+      continue;
+      }
+
+    next = after;
+
+    pending.push_back(value);
+
+    if( !haveDimensions )
+      {
+      if( pending.size() == 2 )
+        {
+        outputDimension = (int)pending[0];
+        inputDimension = (int)pending[1];
+
+        if( outputDimension < 1 || inputDimension < 0 )
+          {
+          printf("error, %s has dimensions %d and %d\n",
+                 path.c_str(), outputDimension, inputDimension);
+          exit(1);
+          }
+
+        haveDimensions = true;
+        pending.clear();
+        }
+
+      continue;
+      }
+
+    if( (int)pending.size() == outputDimension + inputDimension )
+      {
+      Sample* sample = new Sample(outputDimension, inputDimension);
+
+      for( int i = 0; i < outputDimension; i++ )
+        {
+        sample->setOutput(i, pending[i]);
+        }
+
+      for( int i = 0; i < inputDimension; i++ )
+        {
+        sample->setInput(i, pending[outputDimension + i]);
+        }
+
+      samples.push_back(sample);
+      added++;
+
+      pending.clear();
+      }
+    }
+
+  return added;
+  }
+
+
+/**
+ * Whether the dimensions have been read yet, and their values.
+ */
+
+bool SampleFeed::hasDimensions() const
+  {
+  return haveDimensions;
+  }
+
+int SampleFeed::getOutputDimension() const
+  {
+  return outputDimension;
+  }
+
+int SampleFeed::getInputDimension() const
+  {
+  return inputDimension;
+  }
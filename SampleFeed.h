@@ -0,0 +1,86 @@
+// file:    SampleFeed.h
+// purpose: Header file for SampleFeed class
+
+#ifndef __SampleFeed__
+#define __SampleFeed__
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "Sample.h"
+
+/**
+ * A SampleFeed reads Samples from a file that another program keeps
+ * appending to, in the format read by getSamples: the output and input
+ * dimensions, then the output and input values of each sample.
+ *
+ * Each poll reads whatever has been appended since the last one.  Only
+ * complete lines are parsed, so a sample being written is not read half
+ * way; a sample may still span several lines.
+ */
+
+class SampleFeed
+{
+private:
+
+std::string path;
+
+/**
+ * the number of bytes of the file read so far
+ */
+
+long offset;
+
+/**
+ * the text after the last newline read, not yet parsed
+ */
+
+std::string partial;
+
+/**
+ * whether the dimensions have been read, and their values
+ */
+
+bool haveDimensions;
+
+int outputDimension;
+
+int inputDimension;
+
+/**
+ * the values read of a sample not yet complete
+ */
+
+std::vector<double> pending;
+
+public:
+
+/**
+ * constructor, for the file at a path, which need not exist yet
+ */
+
+SampleFeed(const char* _path);
+
+
+/**
+ * Read the samples appended since the last poll onto the end of a list,
+ * returning how many there were.
+ */
+
+int poll(std::list<Sample*>& samples);
+
+
+/**
+ * Whether the dimensions have been read yet, and their values.
+ */
+
+bool hasDimensions() const;
+
+int getOutputDimension() const;
+
+int getInputDimension() const;
+
+}; // class SampleFeed
+
+#endif
@@ -24,3 +24,8 @@ std::string Satlin::getName()
   {
   return "satlin";
   }
+
+bool Satlin::useMatchesAct()
+  {
+  return false;
+  }
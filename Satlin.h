@@ -15,5 +15,7 @@ double deriv(double arg, double value);
 
 std::string getName();
 
+bool useMatchesAct();
+
 };
 #endif
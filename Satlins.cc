@@ -24,3 +24,8 @@ std::string Satlins::getName()
   {
   return "satlins";
   }
+
+bool Satlins::useMatchesAct()
+  {
+  return false;
+  }
@@ -0,0 +1,24 @@
+#include "Softmax.h"
+#include <math.h>
+
+#include <iostream>
+
+double Softmax::act(double arg)
+  {
+  return 0;
+  }
+
+double Softmax::use(double arg)
+  {
+  return 0;
+  }
+
+double Softmax::deriv(double arg, double out)
+  {
+  return 0;
+  }
+
+std::string Softmax::getName()
+  {
+  return "softmax";
+  }
@@ -0,0 +1,20 @@
+#ifndef __Softmax__
+#define __Softmax__
+
+#include "ActivationFunction.h"
+
+class Softmax : public ActivationFunction	// dummy, used only for name
+{
+public:
+
+double act(double arg);
+
+double use(double arg);
+
+double deriv(double arg, double value);
+
+std::string getName();
+
+private:
+};
+#endif
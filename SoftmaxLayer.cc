@@ -0,0 +1,299 @@
+// file:    SoftmaxLayer.cc
+// purpose: C++ code for SoftmaxLayer class
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+
+#include "SoftmaxLayer.h"
+#include "Purelin.h"
+
+/**
+ * the activation function of the Neurons, which give the logits
+ */
+
+static Purelin logit;
+
+
+/**
+ * Turn a row of logits into probabilities in place.  The largest logit is
+ * subtracted first, so that no exponential overflows and the largest is 1.
+ */
+
+static void softmax(double* row, int n)
+  {
+  double largest = row[0];
+
+  for( int i = 1; i < n; i++ )
+    {
+    if( row[i] > largest )
+      {
+      largest = row[i];
+      }
+    }
+
+  double sum = 0;
+
+  for( int i = 0; i < n; i++ )
+    {
+    row[i] = exp(row[i] - largest);
+    sum += row[i];
+    }
+
+  double scale = 1/sum;
+
+  for( int i = 0; i < n; i++ )
+    {
+    row[i] *= scale;
+    }
+  }
+
+
+/**
+ * Return the index of the largest value in a row.
+ */
+
+static int largestIndex(const double* row, int n)
+  {
+  int index = 0;
+
+  for( int i = 1; i < n; i++ )
+    {
+    if( row[i] > row[index] )
+      {
+      index = i;
+      }
+    }
+
+  return index;
+  }
+
+
+/**
+ * Return the cross-entropy loss of the desired category, given its
+ * probability.  A probability that underflowed to 0 counts as the
+ * smallest one, so that the loss stays finite.
+ */
+
+static double crossEntropy(double p)
+  {
+  return -log(p > DBL_MIN ? p : DBL_MIN);
+  }
+
+
+static int getDesired(const Sample& sample, int numberInLayer)
+  {
+  int desired = (int)sample.getOutput(0);
+
+  assert(desired >= 0);
+  assert(desired < numberInLayer);
+
+  return desired;
+  }
+
+
+/**
+ * constructor
+ */
+
+SoftmaxLayer::SoftmaxLayer(int _layerIndex, int _numberInLayer, ActivationFunction* _type,
+                           int _numberOfInputs, Random& random) : Layer()
+  {
+  init(_layerIndex, _numberInLayer, _type, _numberOfInputs, random);
+  }
+
+
+/**
+ * Initialize the layer by specifying the number of categories and the
+ * number of inputs of each Neuron.
+ */
+
+void SoftmaxLayer::init(int _layerIndex, int _numberInLayer, ActivationFunction* _type,
+                        int _numberOfInputs, Random& random)
+  {
+  Layer::init(_layerIndex, _numberInLayer, &logit, _numberOfInputs, random);
+
+  assert( probability = new double[numberInLayer] );
+
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    probability[i] = 1.0/numberInLayer;
+    }
+
+  maxIndex = 0;
+  }
+
+
+/**
+ * The layer is saved and reloaded by the name of the softmax type, rather
+ * than by that of its linear neurons.
+ */
+
+std::string SoftmaxLayer::getType() const
+  {
+  return "softmax";
+  }
+
+
+/**
+ * Get the output of the layer: the index of the most likely category.
+ */
+
+double SoftmaxLayer::get(int i) const
+  {
+  assert(i == 0);
+  return maxIndex;
+  }
+
+
+/**
+ * Fire all the Neurons in this layer, and set the probabilities from
+ * their logits.
+ */
+
+void SoftmaxLayer::fire(const Source& source)
+  {
+  Layer::fire(source);
+
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    probability[i] = neuron[i].getOutput();
+    }
+
+  maxIndex = largestIndex(probability, numberInLayer);
+
+  softmax(probability, numberInLayer);
+  }
+
+
+void SoftmaxLayer::use(const Source& source)
+  {
+  fire(source);
+  }
+
+
+/**
+ * Show the outputs on the standard output stream.
+ */
+
+void SoftmaxLayer::showOutput() const
+  {
+  std::cout << " " << get(0);
+  }
+
+
+/**
+ * Set the sensitivities of the output Neurons to the gradient of the
+ * cross-entropy with respect to their logits.
+ */
+
+void SoftmaxLayer::setSensitivity(const Sample& sample)
+  {
+  int desired = getDesired(sample, numberInLayer);
+
+  for( int i = 0; i < numberInLayer; i++ )
+    {
+    neuron[i].setFixedSensitivity(probability[i] - (i == desired ? 1 : 0));
+    }
+  }
+
+
+/**
+ * Compute the error of the layer, as for a OnehotLayer: 0 if the most
+ * likely category is the desired one, and 1 if not.
+ */
+
+double SoftmaxLayer::computeError(const Sample& sample) const
+  {
+  return (get(0) == sample.getOutput(0)) ? 0 : 1;
+  }
+
+
+/**
+ * Compute the cross-entropy loss on a fired Sample.
+ */
+
+double SoftmaxLayer::computeLoss(const Sample& sample) const
+  {
+  return crossEntropy(probability[getDesired(sample, numberInLayer)]);
+  }
+
+
+/**
+ * Compute the cross-entropy loss from a row of a batch output matrix,
+ * which holds the probabilities.
+ */
+
+double SoftmaxLayer::computeLoss(const Sample& sample, const double* outputRow) const
+  {
+  return crossEntropy(outputRow[getDesired(sample, numberInLayer)]);
+  }
+
+
+/**
+ * There are no residuals whose squares sum to the cross-entropy.
+ */
+
+double SoftmaxLayer::getResidual(const Sample& sample, int i) const
+  {
+  printf("error, a softmax output layer cannot be trained in levenberg-marquardt mode\n");
+  exit(1);
+  }
+
+
+/**
+ * Fire the layer on a batch, then turn each row of logits into the
+ * probabilities of the categories.
+ */
+
+void SoftmaxLayer::fireBatch(const double* input, int batchSize, double* output, double* deriv) const
+  {
+  Layer::fireBatch(input, batchSize, output, deriv);
+
+  for( int b = 0; b < batchSize; b++ )
+    {
+    softmax(output + b*numberInLayer, numberInLayer);
+    }
+  }
+
+
+/**
+ * Get the output value from one row of a batch output matrix,
+ * which is the index of the category with the largest probability.
+ */
+
+double SoftmaxLayer::getBatchOutput(const double* outputRow, int i) const
+  {
+  assert(i == 0);
+  return largestIndex(outputRow, numberInLayer);
+  }
+
+
+/**
+ * Set the sensitivities of the output layer for a batch: each row is its
+ * probabilities less the one-hot target.
+ */
+
+void SoftmaxLayer::setSensitivityBatch(const Sample* const* samples, int batchSize,
+                                       const double* output, const double* deriv,
+                                       double* sensitivity) const
+  {
+  for( int k = 0; k < batchSize*numberInLayer; k++ )
+    {
+    sensitivity[k] = output[k];
+    }
+
+  for( int b = 0; b < batchSize; b++ )
+    {
+    sensitivity[b*numberInLayer + getDesired(*samples[b], numberInLayer)] -= 1;
+    }
+  }
+
+
+SoftmaxLayer::~SoftmaxLayer()
+  {
+  delete [] probability;
+  }
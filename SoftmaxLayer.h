@@ -0,0 +1,117 @@
+// file:    SoftmaxLayer.h
+// purpose: Header file for SoftmaxLayer class
+
+#ifndef __SoftmaxLayer__
+#define __SoftmaxLayer__
+
+#include "Layer.h"
+
+/**
+ * A SoftmaxLayer is an output layer for categories, as a OnehotLayer is:
+ * a Sample's output is the index of its category, and the layer's output is
+ * the index of the category it finds most likely.
+ *
+ * Its Neurons are linear, giving a logit for each category, which the
+ * softmax turns into probabilities.  It is trained by the cross-entropy
+ * loss, -log of the probability of the desired category, whose gradient
+ * with respect to the logits is the probabilities less the one-hot target
+ * for every category at once, with no derivative of an activation function
+ * to vanish.
+ *
+ * The cross-entropy is not a sum of squared residuals, so the layer cannot
+ * be trained in Levenberg-Marquardt mode.
+ */
+
+class SoftmaxLayer : public Layer
+{
+private:
+
+int maxIndex;
+
+/**
+ * the probabilities of the categories for the Sample last fired
+ */
+
+double* probability;
+
+
+public:
+
+/**
+ * constructor
+ */
+
+SoftmaxLayer(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs,
+             Random& random);
+
+
+/**
+ * Initialize the layer by specifying the number of categories and the
+ * number of inputs of each Neuron.
+ */
+
+void init(int _layerIndex, int _numberInLayer, ActivationFunction* type, int _numberInputs,
+          Random& random);
+
+
+std::string getType() const;
+
+
+/**
+ * Get the output of the layer: the index of the most likely category.
+ */
+
+virtual double get(int i) const;
+
+
+/**
+ * Fire all the Neurons in this layer, and set the probabilities from
+ * their logits.
+ */
+
+void fire(const Source& source);
+
+void use(const Source& source);
+
+
+/**
+ * Show the output on the standard output stream.
+ */
+
+void showOutput() const;
+
+
+void setSensitivity(const Sample& sample);
+
+double computeError(const Sample& sample) const;
+
+double computeLoss(const Sample& sample) const;
+
+double computeLoss(const Sample& sample, const double* outputRow) const;
+
+double getResidual(const Sample& sample, int i) const;
+
+
+/**
+ * Fire the layer on a batch, leaving each row of the output matrix with
+ * the probabilities of the categories rather than the logits.
+ */
+
+void fireBatch(const double* input, int batchSize, double* output, double* deriv) const;
+
+double getBatchOutput(const double* outputRow, int i) const;
+
+void setSensitivityBatch(const Sample* const* samples, int batchSize,
+                         const double* output, const double* deriv,
+                         double* sensitivity) const;
+
+
+/**
+ * Destructor
+ */
+
+virtual ~SoftmaxLayer();
+
+}; // class SoftmaxLayer
+
+#endif
@@ -0,0 +1,21 @@
+// file:    Task.h
+// purpose: Header file for Task class
+
+#ifndef __Task__
+#define __Task__
+
+/**
+ * A Task is a piece of work that a ThreadPool runs on one of its threads.
+ */
+
+class Task
+{
+public:
+
+virtual void run() = 0;
+
+virtual ~Task() {}
+
+};
+
+#endif
@@ -0,0 +1,160 @@
+// file:    ThreadPool.cc
+// purpose: C++ code for ThreadPool class
+
+#include "ThreadPool.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+/**
+ * constructor, starting a number of threads
+ */
+
+ThreadPool::ThreadPool(int _numberThreads)
+  {
+  assert( _numberThreads > 0 );
+
+  numberThreads = _numberThreads;
+  running = 0;
+  stopping = false;
+
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&added, NULL);
+  pthread_cond_init(&finished, NULL);
+
+  assert( threads = new pthread_t[numberThreads] );
+
+  for( int i = 0; i < numberThreads; i++ )
+    {
+    if( pthread_create(&threads[i], NULL, work, this) != 0 )
+      {
+      printf("error, cannot start thread %d\n", i);
+      exit(1);
+      }
+    }
+  }
+
+
+/**
+ * Run Tasks from the queue until the pool stops.
+ */
+
+void* ThreadPool::work(void* pool)
+  {
+  ThreadPool* self = (ThreadPool*)pool;
+
+  pthread_mutex_lock(&self->lock);
+
+  for( ;; )
+    {
+    while( self->queue.empty() && !self->stopping )
+      {
+      pthread_cond_wait(&self->added, &self->lock);
+      }
+
+    if( self->queue.empty() )
+      {
+      break;		// stopping, and nothing left to do
+      }
+
+    Task* task = self->queue.front();
+    self->queue.pop_front();
+    self->running++;
+
+    pthread_mutex_unlock(&self->lock);
+
+    task->run();
+
+    pthread_mutex_lock(&self->lock);
+
+    self->running--;
+
+    pthread_cond_broadcast(&self->finished);
+    }
+
+  pthread_mutex_unlock(&self->lock);
+
+  return NULL;
+  }
+
+
+/**
+ * Add a Task to the end of the queue.
+ */
+
+void ThreadPool::add(Task* task)
+  {
+  pthread_mutex_lock(&lock);
+
+  queue.push_back(task);
+
+  pthread_cond_signal(&added);
+
+  pthread_mutex_unlock(&lock);
+  }
+
+
+/**
+ * Wait until every Task added has been run.
+ */
+
+void ThreadPool::wait()
+  {
+  pthread_mutex_lock(&lock);
+
+  while( !queue.empty() || running > 0 )
+    {
+    pthread_cond_wait(&finished, &lock);
+    }
+
+  pthread_mutex_unlock(&lock);
+  }
+
+
+int ThreadPool::getNumberThreads() const
+  {
+  return numberThreads;
+  }
+
+
+/**
+ * Return the number of processors available, which is the default
+ * number of threads.
+ */
+
+int ThreadPool::getProcessorCount()
+  {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return count > 0 ? (int)count : 1;
+  }
+
+
+/**
+ * destructor, which waits for the Tasks added and stops the threads
+ */
+
+ThreadPool::~ThreadPool()
+  {
+  pthread_mutex_lock(&lock);
+
+  stopping = true;
+
+  pthread_cond_broadcast(&added);
+
+  pthread_mutex_unlock(&lock);
+
+  for( int i = 0; i < numberThreads; i++ )
+    {
+    pthread_join(threads[i], NULL);
+    }
+
+  delete [] threads;
+
+  pthread_cond_destroy(&finished);
+  pthread_cond_destroy(&added);
+  pthread_mutex_destroy(&lock);
+  }
@@ -0,0 +1,95 @@
+// file:    ThreadPool.h
+// purpose: Header file for ThreadPool class
+
+#ifndef __ThreadPool__
+#define __ThreadPool__
+
+#include <list>
+#include <pthread.h>
+
+#include "Task.h"
+
+/**
+ * A ThreadPool runs Tasks on a fixed number of threads, each taking the
+ * next Task from a queue as soon as it finishes one, in the order they
+ * were added.  The Tasks still belong to the caller.
+ */
+
+class ThreadPool
+{
+private:
+
+int numberThreads;
+
+pthread_t* threads;
+
+std::list<Task*> queue;
+
+/**
+ * the number of Tasks being run
+ */
+
+int running;
+
+/**
+ * whether the threads should exit once the queue is empty
+ */
+
+bool stopping;
+
+pthread_mutex_t lock;
+
+/**
+ * signalled when a Task is added or the pool is stopping, and when a
+ * Task finishes
+ */
+
+pthread_cond_t added;
+
+pthread_cond_t finished;
+
+static void* work(void* pool);
+
+public:
+
+/**
+ * constructor, starting a number of threads
+ */
+
+ThreadPool(int _numberThreads);
+
+
+/**
+ * Add a Task to the end of the queue.
+ */
+
+void add(Task* task);
+
+
+/**
+ * Wait until every Task added has been run.
+ */
+
+void wait();
+
+
+int getNumberThreads() const;
+
+
+/**
+ * Return the number of processors available, which is the default
+ * number of threads.
+ */
+
+static int getProcessorCount();
+
+
+/**
+ * destructor, which waits for the Tasks added and stops the threads
+ */
+
+~ThreadPool();
+
+}; // class ThreadPool
+
+#endif
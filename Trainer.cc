@@ -0,0 +1,1944 @@
+// file:    Trainer.cc
+// purpose: C++ code for Trainer class
+
+#include "Trainer.h"
+#include "Trace.h"
+#include "helper.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+
+std::string modeName[] = {"on-line", "batch", "rprop", "mini-batch", "lbfgs",
+                          "levenberg-marquardt"};
+
+std::string scheduleName[] = {"constant", "step decay", "cosine", "bold driver"};
+
+std::string reasonName[] = {"", "goal reached", "limit exceeded", "lack of progress",
+                            "no validation progress",
+                            "time limit exceeded", "gradient budget exceeded"};
+
+/**
+ * the first values of a checkpoint file, identifying it and its layout
+ */
+
+static const int checkpointMagic   = 0x4b43524e;	// "NRCK"
+
+static const int checkpointVersion = 4;
+
+
+/**
+ * constructor
+ */
+
+Trainer::Trainer(Network& _network, std::list<Sample*>& trainingSamples,
+                 MODE _mode, double _rate, double _goal, int _epochLimit)
+  : network(_network), samples(trainingSamples.begin(), trainingSamples.end()),
+    originalSamples(samples)
+  {
+  mode = _mode;
+  rate = initialRate = _rate;
+  goal = _goal;
+  epochLimit = _epochLimit;
+
+  batchSize = defaultBatchSize;
+
+  fullBatch = false;
+
+  batch = NULL;
+
+  optimizer = NULL;
+
+  lbfgs = NULL;
+  lbfgsMemory = defaultLbfgsMemory;
+  lbfgsWeights = lbfgsGradient = trialWeights = trialGradient = direction = NULL;
+  lbfgsLoss = lbfgsSse = 0;
+  lbfgsUsageError = 0;
+
+  lm = NULL;
+  mu = defaultMu;
+  stalled = false;
+
+  fusedUsage = network.useMatchesFire() && mode != LM;
+  usageInterval = 1;
+  usageSamples = samples;
+  passUsageError = 0;
+  usageCounted = false;
+
+  patience = defaultPatience;
+  validateOnUsage = false;
+  validationMse = 0;
+  validationUsageError = 0;
+  bestValidation = 0;
+  bestEpoch = 0;
+  bestWeights = NULL;
+
+  timeLimit = 0;
+  gradientLimit = 0;
+  progressInterval = 0;
+  startTime = lastProgressTime = elapsedTime = 0;
+  gradientCount = 0;
+
+  checkpointInterval = 0;
+  started = false;
+
+  numberThreads = 1;
+  deterministic = false;
+  pool = NULL;
+  numberBlocks = 0;
+  slots = NULL;
+
+  ring = NULL;
+  totalSamples = samples.size();
+  ringValues = NULL;
+
+  selection = SELECT_ALL;
+  selectionLoss = 0;
+  revisitInterval = defaultRevisitInterval;
+  backpropagated = 0;
+
+  schedule = CONSTANT_RATE;
+  decayFactor = defaultDecayFactor;
+  decayInterval = defaultDecayInterval;
+  growFactor = defaultGrowFactor;
+  shrinkFactor = defaultShrinkFactor;
+  rollback = false;
+  startWeights = acceptedWeights = NULL;
+  haveAcceptedWeights = false;
+  rolledBack = false;
+
+  epoch = 0;
+  mse = 1+goal;
+  oldmse = 2+goal;
+  usageError = 0;
+  reason = NONE;
+  }
+
+
+/**
+ * Set the number of samples per weight update in mini-batch mode.
+ */
+
+void Trainer::setBatchSize(int _batchSize)
+  {
+  assert( _batchSize > 0 );
+  assert( batch == NULL );
+  batchSize = _batchSize;
+  }
+
+
+/**
+ * Set the rprop variant and constants used in rprop mode.
+ */
+
+void Trainer::setRprop(const Rprop& _rprop)
+  {
+  rprop = _rprop;
+  }
+
+
+/**
+ * Make batch and rprop modes use only full-batch gradients, rather than
+ * also adjusting the weights after each sample.
+ */
+
+void Trainer::setFullBatch(bool _fullBatch)
+  {
+  assert( !_fullBatch || mode == BATCH || mode == RPROP );
+  fullBatch = _fullBatch;
+  }
+
+
+/**
+ * Use (a copy of) an Optimizer for the weight updates in on-line
+ * or mini-batch mode.
+ */
+
+void Trainer::setOptimizer(const Optimizer& _optimizer)
+  {
+  assert( mode == ONLINE || mode == MINIBATCH );
+  delete optimizer;
+  optimizer = _optimizer.clone();
+  }
+
+
+/**
+ * Set the number of step and gradient change pairs remembered in lbfgs mode.
+ */
+
+void Trainer::setLbfgsMemory(int _lbfgsMemory)
+  {
+  assert( _lbfgsMemory > 0 );
+  assert( lbfgs == NULL );
+  lbfgsMemory = _lbfgsMemory;
+  }
+
+
+/**
+ * Set the initial damping used in Levenberg-Marquardt mode.
+ */
+
+void Trainer::setMu(double _mu)
+  {
+  assert( _mu > 0 );
+  assert( lm == NULL );
+  mu = _mu;
+  }
+
+
+/**
+ * Count usage errors with a separate pass only every so many epochs,
+ * when they cannot be counted from the training pass.
+ */
+
+void Trainer::setUsageInterval(int _usageInterval)
+  {
+  assert( _usageInterval > 0 );
+  usageInterval = _usageInterval;
+  }
+
+
+/**
+ * Count usage errors with a separate pass on a random subset of this many
+ * training samples, when they cannot be counted from the training pass.
+ */
+
+void Trainer::setUsageSampleSize(int size)
+  {
+  assert( size > 0 );
+
+  usageSamples = samples;
+
+  int nSamples = usageSamples.size();
+
+  if( size >= nSamples )
+    {
+    return;
+    }
+
+  // The first size entries of a partial Fisher-Yates shuffle.
+
+  for( int i = 0; i < size; i++ )
+    {
+    int j = i + (int)(network.getRandom().uniform()*(nSamples-i));
+    Sample* temp = usageSamples[i];
+    usageSamples[i] = usageSamples[j];
+    usageSamples[j] = temp;
+    }
+
+  usageSamples.resize(size);
+  }
+
+
+/**
+ * Stop training once the error on a set of validation samples has not
+ * improved for patience epochs, and end with the weights that did best.
+ * The error watched is the usage error if onUsage, otherwise the mse.
+ */
+
+void Trainer::setValidation(std::list<Sample*>& _validationSamples, int _patience, bool onUsage)
+  {
+  assert( !_validationSamples.empty() );
+  assert( _patience > 0 );
+
+  validationSamples.assign(_validationSamples.begin(), _validationSamples.end());
+  patience = _patience;
+  validateOnUsage = onUsage;
+  }
+
+
+/**
+ * Stop training after so many seconds of wall-clock time, or 0 for no limit.
+ */
+
+void Trainer::setTimeLimit(double seconds)
+  {
+  assert( seconds >= 0 );
+  timeLimit = seconds;
+  }
+
+
+/**
+ * Stop training after so many sample gradients (one per sample and epoch
+ * in most modes), or 0 for no limit.
+ */
+
+void Trainer::setGradientLimit(double gradients)
+  {
+  assert( gradients >= 0 );
+  gradientLimit = gradients;
+  }
+
+
+/**
+ * Report progress on the standard output every so many seconds, or 0
+ * for no reports.
+ */
+
+void Trainer::setProgressInterval(double seconds)
+  {
+  assert( seconds >= 0 );
+  progressInterval = seconds;
+  }
+
+
+/**
+ * Backpropagate only some of the samples in on-line mode, or in batch or
+ * rprop mode without full-batch gradients.
+ */
+
+void Trainer::setSelection(SELECTION _selection, double loss, int revisit)
+  {
+  assert( loss > 0 && revisit > 0 );
+  assert( mode == ONLINE || ((mode == BATCH || mode == RPROP) && !fullBatch) );
+  selection = _selection;
+  selectionLoss = loss;
+  revisitInterval = revisit;
+  }
+
+
+/**
+ * Compute full-batch gradients on a number of threads.
+ */
+
+void Trainer::setThreads(int threads, bool _deterministic)
+  {
+  assert( threads > 0 );
+  assert( parts.empty() );
+  numberThreads = threads;
+  deterministic = _deterministic;
+  }
+
+
+/**
+ * Multiply the learning rate by factor every interval epochs.
+ */
+
+void Trainer::setStepDecay(double factor, int interval)
+  {
+  assert( factor > 0 && interval > 0 );
+  schedule = STEP_DECAY;
+  decayFactor = factor;
+  decayInterval = interval;
+  }
+
+
+/**
+ * Lower the learning rate along a half cosine to 0 at the epoch limit.
+ */
+
+void Trainer::setCosine()
+  {
+  schedule = COSINE;
+  }
+
+
+/**
+ * Adapt the learning rate by the bold driver rule, optionally rolling
+ * back an epoch that raises the mse.
+ */
+
+void Trainer::setBoldDriver(double grow, double shrink, bool _rollback)
+  {
+  assert( grow >= 1 && shrink > 0 && shrink < 1 );
+  schedule = BOLD_DRIVER;
+  growFactor = grow;
+  shrinkFactor = shrink;
+  rollback = _rollback;
+
+  if( rollback && startWeights == NULL )
+    {
+    int n = network.getParameterCount();
+
+    assert( startWeights = new double[n] );
+    assert( acceptedWeights = new double[n] );
+    }
+  }
+
+
+/**
+ * Set the learning rate for the next epoch from the schedule.  Step decay
+ * and the cosine depend only on the epoch; the bold driver's rate is
+ * adapted at the end of each epoch instead.  With full-batch gradients the
+ * epoch's mse is that of the weights it starts from, which a rollback may
+ * return to, so they are kept here.
+ */
+
+void Trainer::scheduleRate()
+  {
+  if( schedule == STEP_DECAY )
+    {
+    rate = initialRate*pow(decayFactor, epoch/decayInterval);
+    }
+  else if( schedule == COSINE )
+    {
+    rate = 0.5*initialRate*(1 + cos(M_PI*epoch/epochLimit));
+    }
+  else if( schedule == BOLD_DRIVER && rollback && fullBatch )
+    {
+    network.getWeights(startWeights);
+    }
+  }
+
+
+/**
+ * Adapt the bold driver's learning rate to the mse of the epoch just run.
+ *
+ * The weights accepted are those whose mse was measured: the weights at
+ * the end of the epoch when the mse is summed as the updates go on, or at
+ * its start with full-batch gradients.
+ *
+ * The epoch after a rollback is not judged, but sets the mse the next is
+ * judged by.  With full-batch gradients it measures the accepted weights
+ * again; otherwise its mse, summed with the smaller rate, is not comparable
+ * with the last one (an mse summed while a large rate chases each sample
+ * can be lower than that of any one set of weights), and judging it would
+ * roll back again and again.
+ */
+
+void Trainer::adaptRate()
+  {
+  bool judged = !rolledBack;
+
+  rolledBack = false;
+
+  if( judged && mse > oldmse )
+    {
+    rate *= shrinkFactor;
+
+    if( rollback && haveAcceptedWeights )
+      {
+      network.setWeights(acceptedWeights);
+      mse = oldmse;
+      rolledBack = true;
+      }
+    }
+  else
+    {
+    if( judged && mse < oldmse )
+      {
+      rate *= growFactor;
+      }
+
+    if( rollback && fullBatch )
+      {
+      double* weights = acceptedWeights;
+      acceptedWeights = startWeights;
+      startWeights = weights;
+      haveAcceptedWeights = true;
+      }
+    else if( rollback )
+      {
+      network.getWeights(acceptedWeights);
+      haveAcceptedWeights = true;
+      }
+    }
+  }
+
+
+/**
+ * Train in batch or rprop mode with full-batch gradients as one of the
+ * workers in a Ring.
+ */
+
+void Trainer::setRing(Ring* _ring)
+  {
+  assert( fullBatch && (mode == BATCH || mode == RPROP) );
+  assert( ringValues == NULL );
+
+  ring = _ring;
+
+  double count = samples.size();
+
+  ring->allReduce(&count, 1);
+
+  totalSamples = (int)count;
+
+  assert( ringValues = new double[network.getParameterCount()+2] );
+  }
+
+
+/**
+ * Present every sample once, one at a time, returning the sse.
+ */
+
+double Trainer::runSamples()
+  {
+  double sse = 0;
+
+  bool selecting = selection != SELECT_ALL && epoch%revisitInterval != 0;
+
+  backpropagated = 0;
+
+  switch( mode )
+    {
+    case RPROP:
+    case BATCH:
+      network.clearAccumulation();
+    default:
+      ;
+    }
+
+  for( std::vector<Sample*>::iterator sample = samples.begin();
+       sample != samples.end();
+       sample++
+     )
+    {
+    // forward propagation
+
+    network.fire(**sample);
+
+    double sampleSSE = network.computeError(**sample);
+
+    sse += sampleSSE;
+
+    if( fusedUsage )
+      {
+      passUsageError += (network.computeUsageError(**sample) != 0);
+      }
+
+    if( Trace::atLevel(4) )
+      {
+      printf("\nforward output: ");
+      network.showOutput();
+
+      (*sample)->show();
+
+      printf(", sample sse: % 6.3f\n", sampleSSE);
+      }
+
+    // Selective backpropagation skips the samples already fit well, or
+    // weights those chosen by the inverse of their chance of being chosen.
+
+    double weight = 1;
+
+    if( selecting )
+      {
+      double loss = network.computeLoss(**sample);
+
+      if( selection == SKIP_BELOW && loss < selectionLoss )
+        {
+        continue;
+        }
+
+      if( selection == SAMPLE_BY_LOSS && loss < selectionLoss )
+        {
+        double probability = loss/selectionLoss;
+
+        if( probability < minimumSelectionProbability )
+          {
+          probability = minimumSelectionProbability;
+          }
+
+        if( network.getRandom().uniform() >= probability )
+          {
+          continue;
+          }
+
+        weight = 1/probability;
+        }
+      }
+
+    backpropagated++;
+
+    // backpropagation
+
+    network.setSensitivity(**sample);
+
+    if( weight != 1 )
+      {
+      network.scaleSensitivity(weight);
+      }
+
+      switch( mode )
+	{
+	case RPROP:
+          network.accumulateGradient(**sample);
+	case BATCH:
+          network.accumulateWeights(**sample, rate);
+	case ONLINE:
+          if( optimizer )
+            {
+            network.accumulateGradient(**sample);
+            network.adjustByOptimizer(*optimizer, rate, 1);
+            }
+          else
+            {
+            network.adjustWeights(**sample, rate);
+            }
+	default:
+	  ;
+	}
+
+    if( Trace::atLevel(4) )
+      {
+      network.showWeights("current");
+      }
+    }
+
+  switch( mode )
+    {
+    case RPROP:
+      network.adjustByRprop(rprop, sse/samples.size() > oldmse);
+      break;
+
+    case BATCH:
+      network.installAccumulation();
+
+    default:
+      ;
+    }
+
+  gradientCount += backpropagated;
+
+  return sse;
+  }
+
+
+/**
+ * Present every sample once, in shuffled mini-batches, returning the sse.
+ *
+ * Each batch is fired and backpropagated as matrix products, and the weights
+ * are then moved against the average gradient of the batch, so that the
+ * learning rate means the same as in on-line mode, either directly or by
+ * the Optimizer.
+ */
+
+double Trainer::runMinibatches()
+  {
+  if( batch == NULL )
+    {
+    batch = new Batch(network, batchSize);
+    }
+
+  int nSamples = samples.size();
+
+  // Fisher-Yates shuffle, so that each epoch sees different batches.
+
+  for( int i = nSamples-1; i > 0; i-- )
+    {
+    int j = (int)(network.getRandom().uniform()*(i+1));
+    Sample* temp = samples[i];
+    samples[i] = samples[j];
+    samples[j] = temp;
+    }
+
+  double sse = 0;
+
+  network.clearAccumulation();
+
+  for( int first = 0; first < nSamples; first += batchSize )
+    {
+    int n = nSamples - first < batchSize ? nSamples - first : batchSize;
+
+    batch->load(&samples[first], n);
+
+    // forward propagation
+
+    network.fireBatch(*batch);
+
+    for( int b = 0; b < n; b++ )
+      {
+      sse += network.computeError(*batch, b);
+
+      if( fusedUsage )
+        {
+        passUsageError += network.computeUsageError(*batch, b);
+        }
+      }
+
+    // backpropagation
+
+    network.setSensitivityBatch(*batch);
+
+    network.accumulateGradientBatch(*batch);
+
+    gradientCount += n;
+
+    if( optimizer )
+      {
+      network.adjustByOptimizer(*optimizer, rate, 1.0/n);
+      }
+    else
+      {
+      network.descendGradient(rate/n);
+      }
+
+    if( Trace::atLevel(4) )
+      {
+      network.showWeights("current");
+      }
+    }
+
+  return sse;
+  }
+
+
+/**
+ * Fire and backpropagate every sample at the current weights, as matrix
+ * products over chunks of samples, leaving the summed gradient of the loss
+ * in the accumulation.  Returns the summed loss, and sets sse to the summed
+ * error.
+ *
+ * Up to fullBatchCapacity samples go through at once, so with no more
+ * samples than that, each layer's gradient is a single matrix product.
+ */
+
+double Trainer::computeGradient(double& sse)
+  {
+  if( numberThreads > 1 || deterministic )
+    {
+    return computeGradientInParts(sse);
+    }
+
+  int nSamples = samples.size();
+
+  if( batch == NULL )
+    {
+    batch = new Batch(network, nSamples < fullBatchCapacity ? nSamples : fullBatchCapacity);
+    }
+
+  int capacity = batch->getCapacity();
+
+  double loss = 0;
+
+  sse = 0;
+
+  passUsageError = 0;
+
+  network.clearAccumulation();
+
+  for( int first = 0; first < nSamples; first += capacity )
+    {
+    int n = nSamples - first < capacity ? nSamples - first : capacity;
+
+    batch->load(&samples[first], n);
+
+    network.fireBatch(*batch);
+
+    for( int b = 0; b < n; b++ )
+      {
+      sse += network.computeError(*batch, b);
+
+      loss += network.computeLoss(*batch, b);
+
+      if( fusedUsage )
+        {
+        passUsageError += network.computeUsageError(*batch, b);
+        }
+      }
+
+    network.setSensitivityBatch(*batch);
+
+    network.accumulateGradientBatch(*batch);
+
+    gradientCount += n;
+    }
+
+  return loss;
+  }
+
+
+/**
+ * Sum the accumulated gradient, the sse and the usage errors of the
+ * training pass with those of the other workers in the Ring, returning
+ * the total sse.
+ */
+
+double Trainer::reduceGradient(double sse)
+  {
+  int n = network.getParameterCount();
+
+  network.getGradient(ringValues);
+
+  ringValues[n] = sse;
+  ringValues[n+1] = passUsageError;
+
+  ring->allReduce(ringValues, n+2);
+
+  network.setGradient(ringValues);
+
+  passUsageError = (int)ringValues[n+1];
+
+  return ringValues[n];
+  }
+
+
+/**
+ * A share of a full-batch gradient, computed on one thread: the blocks of
+ * samples first, first+step, and so on, each fired through the part's own
+ * Batch, with the block's gradient, loss, sse and usage errors summed in
+ * its own slot of getParameterCount()+3 values.
+ */
+
+class GradientPart : public Task
+{
+public:
+
+const Network* network;
+
+const std::vector<Sample*>* samples;
+
+int blockSize;
+
+int first;
+
+int step;
+
+bool fusedUsage;
+
+Batch* batch;
+
+double* slots;
+
+int slotSize;
+
+void run()
+  {
+  int n = slotSize - 3;
+  int nSamples = samples->size();
+  int capacity = batch->getCapacity();
+
+  for( int block = first; block*blockSize < nSamples; block += step )
+    {
+    double* slot = slots + block*slotSize;
+
+    for( int k = 0; k < slotSize; k++ )
+      {
+      slot[k] = 0;
+      }
+
+    int end = (block+1)*blockSize < nSamples ? (block+1)*blockSize : nSamples;
+
+    for( int start = block*blockSize; start < end; start += capacity )
+      {
+      int count = end - start < capacity ? end - start : capacity;
+
+      batch->load(&(*samples)[start], count);
+
+      network->fireBatch(*batch);
+
+      for( int b = 0; b < count; b++ )
+        {
+        slot[n] += network->computeLoss(*batch, b);
+        slot[n+1] += network->computeError(*batch, b);
+
+        if( fusedUsage )
+          {
+          slot[n+2] += network->computeUsageError(*batch, b);
+          }
+        }
+
+      network->setSensitivityBatch(*batch);
+
+      network->addGradientBatch(*batch, slot);
+      }
+    }
+  }
+
+~GradientPart()
+  {
+  delete batch;
+  }
+};
+
+
+/**
+ * Compute the full-batch gradient as computeGradient does, over blocks
+ * of samples on numberThreads threads, summing the blocks' results in a
+ * fixed-shape tree.
+ */
+
+double Trainer::computeGradientInParts(double& sse)
+  {
+  int n = network.getParameterCount();
+  int nSamples = samples.size();
+  int slotSize = n+3;		// the gradient, loss, sse and usage errors
+
+  if( parts.empty() )
+    {
+    int blockSize = deterministic ? reductionBlockSize
+                                  : (nSamples + numberThreads - 1)/numberThreads;
+
+    if( blockSize < 1 )
+      {
+      blockSize = 1;
+      }
+
+    numberBlocks = (nSamples + blockSize - 1)/blockSize;
+
+    assert( slots = new double[(numberBlocks > 0 ? numberBlocks : 1)*slotSize] );
+
+    for( int k = 0; k < slotSize; k++ )
+      {
+      slots[k] = 0;		// the sums, if there are no samples
+      }
+
+    for( int t = 0; t < numberThreads; t++ )
+      {
+      GradientPart* part = new GradientPart();
+
+      part->network = &network;
+      part->samples = &samples;
+      part->blockSize = blockSize;
+      part->first = t;
+      part->step = numberThreads;
+      part->fusedUsage = fusedUsage;
+      part->batch = new Batch(network, blockSize < fullBatchCapacity ? blockSize : fullBatchCapacity);
+      part->slots = slots;
+      part->slotSize = slotSize;
+
+      parts.push_back(part);
+      }
+
+    if( numberThreads > 1 )
+      {
+      pool = new ThreadPool(numberThreads);
+      }
+    }
+
+  if( pool )
+    {
+    for( int t = 0; t < numberThreads; t++ )
+      {
+      pool->add(parts[t]);
+      }
+
+    pool->wait();
+    }
+  else
+    {
+    parts[0]->run();
+    }
+
+  // Sum the blocks pairwise, in the same order whichever threads did them.
+
+  for( int stride = 1; stride < numberBlocks; stride *= 2 )
+    {
+    for( int block = 0; block + stride < numberBlocks; block += 2*stride )
+      {
+      double* sum = slots + block*slotSize;
+      const double* other = slots + (block + stride)*slotSize;
+
+      for( int k = 0; k < slotSize; k++ )
+        {
+        sum[k] += other[k];
+        }
+      }
+    }
+
+  network.setGradient(slots);
+
+  sse = slots[n+1];
+
+  passUsageError = (int)slots[n+2];
+
+  gradientCount += nSamples;
+
+  return slots[n];
+  }
+
+
+/**
+ * Take one batch or rprop step from the full-batch gradient, returning
+ * the sse.
+ */
+
+double Trainer::runFullBatch()
+  {
+  double sse;
+
+  computeGradient(sse);
+
+  if( ring )
+    {
+    sse = reduceGradient(sse);
+
+    gradientCount += totalSamples - samples.size();	// the other workers'
+    }
+
+  if( mode == RPROP )
+    {
+    network.adjustByRprop(rprop, sse/totalSamples > oldmse);
+    }
+  else
+    {
+    network.descendGradient(rate);
+    }
+
+  if( Trace::atLevel(4) )
+    {
+    network.showWeights("current");
+    }
+
+  return sse;
+  }
+
+
+/**
+ * Set the network weights and compute the mean loss there and its gradient.
+ */
+
+double Trainer::evaluate(const double* weights, double* gradient, double& sse)
+  {
+  int n = network.getParameterCount();
+
+  network.setWeights(weights);
+
+  double loss = computeGradient(sse);
+
+  network.getGradient(gradient);
+
+  double scale = 1.0/samples.size();
+
+  for( int j = 0; j < n; j++ )
+    {
+    gradient[j] *= scale;
+    }
+
+  return loss*scale;
+  }
+
+
+static double dot(int n, const double* a, const double* b)
+  {
+  double sum = 0;
+  for( int j = 0; j < n; j++ )
+    {
+    sum += a[j]*b[j];
+    }
+  return sum;
+  }
+
+
+/**
+ * Take one L-BFGS step with a backtracking line search, returning the sse
+ * at the new weights.
+ *
+ * The step must decrease the mean loss by at least a small fraction of what
+ * the slope promises (the Armijo condition).  Each failed trial shrinks the
+ * step by minimizing the quadratic through the loss and slope at the current
+ * weights and the loss at the trial, kept within [0.1, 0.5] of the old step.
+ */
+
+double Trainer::runLbfgs()
+  {
+  int n = network.getParameterCount();
+
+  if( lbfgs == NULL )
+    {
+    lbfgs = new Lbfgs(n, lbfgsMemory);
+
+    assert( lbfgsWeights = new double[n] );
+    assert( lbfgsGradient = new double[n] );
+    assert( trialWeights = new double[n] );
+    assert( trialGradient = new double[n] );
+    assert( direction = new double[n] );
+
+    network.getWeights(lbfgsWeights);
+
+    lbfgsLoss = evaluate(lbfgsWeights, lbfgsGradient, lbfgsSse);
+
+    lbfgsUsageError = passUsageError;
+    }
+
+  const int maxTrials = 20;
+  const double sufficientDecrease = 1e-4;
+
+  lbfgs->computeDirection(lbfgsGradient, direction);
+
+  double slope = dot(n, lbfgsGradient, direction);
+
+  if( !(slope < 0) )
+    {
+    // not a descent direction; start over from steepest descent
+
+    lbfgs->reset();
+    lbfgs->computeDirection(lbfgsGradient, direction);
+    slope = dot(n, lbfgsGradient, direction);
+    }
+
+  // Steepest descent has no scale, so it starts with a unit-length step.
+
+  bool steepest = (lbfgs->getCount() == 0);
+
+  double step = steepest ? 1/sqrt(-slope) : 1;
+
+  double trialLoss = lbfgsLoss;
+  double trialSse = lbfgsSse;
+  bool accepted = false;
+
+  for( int trial = 0; trial < maxTrials && !accepted; trial++ )
+    {
+    for( int j = 0; j < n; j++ )
+      {
+      trialWeights[j] = lbfgsWeights[j] + step*direction[j];
+      }
+
+    trialLoss = evaluate(trialWeights, trialGradient, trialSse);
+
+    if( trialLoss <= lbfgsLoss + sufficientDecrease*step*slope )
+      {
+      accepted = true;
+      }
+    else
+      {
+      double next = -slope*step*step/(2*(trialLoss - lbfgsLoss - slope*step));
+
+      if( !(next > 0.1*step) ) next = 0.1*step;
+      if( next > 0.5*step ) next = 0.5*step;
+
+      step = next;
+      }
+    }
+
+  if( !accepted )
+    {
+    network.setWeights(lbfgsWeights);
+
+    lbfgs->reset();
+
+    stalled = steepest;		// even steepest descent found nothing better
+
+    passUsageError = lbfgsUsageError;
+
+    return lbfgsSse;
+    }
+
+  // Remember the step and gradient change, reusing the trial arrays.
+
+  for( int j = 0; j < n; j++ )
+    {
+    direction[j] = trialWeights[j] - lbfgsWeights[j];
+    lbfgsGradient[j] = trialGradient[j] - lbfgsGradient[j];
+    }
+
+  lbfgs->update(direction, lbfgsGradient);
+
+  double* temp = lbfgsWeights;
+  lbfgsWeights = trialWeights;
+  trialWeights = temp;
+
+  temp = lbfgsGradient;
+  lbfgsGradient = trialGradient;
+  trialGradient = temp;
+
+  lbfgsLoss = trialLoss;
+  lbfgsSse = trialSse;
+  lbfgsUsageError = passUsageError;	// counted at the accepted trial
+
+  return lbfgsSse;
+  }
+
+
+/**
+ * Take one Levenberg-Marquardt step, returning the sse at the new weights.
+ */
+
+double Trainer::runLevenbergMarquardt()
+  {
+  if( lm == NULL )
+    {
+    lm = new LevenbergMarquardt(network, samples, mu);
+    }
+
+  double sse;
+
+  stalled = !lm->iterate(sse);	// no damping gave a better step
+
+  gradientCount += (double)samples.size()*network.getResidualCount();	// Jacobian rows
+
+  if( Trace::atLevel(3) )
+    {
+    printf("\nmu: %g\n", lm->getMu());
+    }
+
+  return sse;
+  }
+
+
+/**
+ * Count the usage samples on which the network disagrees when used.
+ */
+
+int Trainer::countUsageErrors()
+  {
+  int errors = 0;
+
+  for( std::vector<Sample*>::iterator sample = usageSamples.begin();
+       sample != usageSamples.end();
+       sample++)
+    {
+    // evaluation with "use"
+
+    network.use(**sample);
+
+    errors += (network.computeUsageError(**sample) != 0);
+    }
+
+  return errors;
+  }
+
+
+/**
+ * Measure the error on the validation samples, remembering the weights
+ * if it is the best so far.
+ */
+
+void Trainer::validate()
+  {
+  bool fused = network.useMatchesFire();
+
+  double sse = 0;
+  int errors = 0;
+
+  for( std::vector<Sample*>::iterator sample = validationSamples.begin();
+       sample != validationSamples.end();
+       sample++)
+    {
+    network.fire(**sample);
+
+    sse += network.computeError(**sample);
+
+    if( fused )
+      {
+      errors += (network.computeUsageError(**sample) != 0);
+      }
+    }
+
+  if( !fused && validateOnUsage )
+    {
+    for( std::vector<Sample*>::iterator sample = validationSamples.begin();
+         sample != validationSamples.end();
+         sample++)
+      {
+      network.use(**sample);
+
+      errors += (network.computeUsageError(**sample) != 0);
+      }
+    }
+
+  validationMse = sse/validationSamples.size();
+  validationUsageError = errors;
+
+  double value = validateOnUsage ? errors : validationMse;
+
+  if( bestWeights == NULL )
+    {
+    assert( bestWeights = new double[network.getParameterCount()] );
+    }
+  else if( value >= bestValidation )
+    {
+    return;
+    }
+
+  bestValidation = value;
+  bestEpoch = epoch;
+  network.getWeights(bestWeights);
+  }
+
+
+/**
+ * Record the sample pointers in a list as their original indices, or
+ * replace them by the Samples at the indices recorded.
+ */
+
+void Trainer::putSamples(Checkpoint& checkpoint, const std::vector<Sample*>& list) const
+  {
+  std::map<const Sample*, int> index;
+
+  for( int i = 0; i < (int)originalSamples.size(); i++ )
+    {
+    index[originalSamples[i]] = i;
+    }
+
+  checkpoint.putInt(list.size());
+
+  for( std::vector<Sample*>::const_iterator sample = list.begin();
+       sample != list.end();
+       sample++
+     )
+    {
+    checkpoint.putInt(index[*sample]);
+    }
+  }
+
+void Trainer::getSamples(Checkpoint& checkpoint, std::vector<Sample*>& list)
+  {
+  int n = checkpoint.getInt();
+
+  if( n < 0 || n > (int)originalSamples.size() )
+    {
+    printf("error, the checkpoint does not match the training samples\n");
+    exit(1);
+    }
+
+  list.resize(n);
+
+  for( int i = 0; i < n; i++ )
+    {
+    int k = checkpoint.getInt();
+
+    if( k < 0 || k >= (int)originalSamples.size() )
+      {
+      printf("error, the checkpoint does not match the training samples\n");
+      exit(1);
+      }
+
+    list[i] = originalSamples[k];
+    }
+  }
+
+
+/**
+ * Save or restore everything training depends on: the weights and
+ * per-weight state, the optimizer, the epoch and error history, the
+ * sample order and the random number states.
+ *
+ * The settings (mode, rate, limits and so on) are not saved; they come
+ * from the command line again, and only the mode and sample count are
+ * checked.
+ */
+
+void Trainer::saveState(Checkpoint& checkpoint) const
+  {
+  int n = network.getParameterCount();
+
+  checkpoint.putInt(checkpointMagic);
+  checkpoint.putInt(checkpointVersion);
+  checkpoint.putInt(mode);
+  checkpoint.putInt(originalSamples.size());
+
+  checkpoint.putInt(epoch);
+  checkpoint.putDouble(mse);
+  checkpoint.putDouble(oldmse);
+  checkpoint.putInt(usageError);
+  checkpoint.putInt(usageCounted);
+  checkpoint.putInt(stalled);
+  checkpoint.putDouble(gradientCount);
+  checkpoint.putDouble(elapsedTime);
+
+  putSamples(checkpoint, samples);
+  putSamples(checkpoint, usageSamples);
+
+  // early stopping
+
+  checkpoint.putDouble(validationMse);
+  checkpoint.putInt(validationUsageError);
+  checkpoint.putDouble(bestValidation);
+  checkpoint.putInt(bestEpoch);
+  checkpoint.putInt(bestWeights != NULL);
+
+  if( bestWeights )
+    {
+    checkpoint.putDoubles(bestWeights, n);
+    }
+
+  network.saveState(checkpoint);
+
+  checkpoint.putInt(optimizer != NULL);
+
+  if( optimizer )
+    {
+    optimizer->saveState(checkpoint);
+    }
+
+  checkpoint.putInt(lbfgs != NULL);
+
+  if( lbfgs )
+    {
+    lbfgs->saveState(checkpoint);
+    checkpoint.putDoubles(lbfgsWeights, n);
+    checkpoint.putDoubles(lbfgsGradient, n);
+    checkpoint.putDouble(lbfgsLoss);
+    checkpoint.putDouble(lbfgsSse);
+    checkpoint.putInt(lbfgsUsageError);
+    }
+
+  checkpoint.putInt(lm != NULL);
+
+  if( lm )
+    {
+    checkpoint.putDouble(lm->getMu());
+    }
+
+  // the bold driver's adapted rate and the weights it would roll back to
+
+  checkpoint.putInt(schedule == BOLD_DRIVER);
+
+  if( schedule == BOLD_DRIVER )
+    {
+    checkpoint.putDouble(rate);
+    checkpoint.putInt(rolledBack);
+    checkpoint.putInt(haveAcceptedWeights);
+
+    if( haveAcceptedWeights )
+      {
+      checkpoint.putDoubles(acceptedWeights, n);
+      }
+    }
+  }
+
+void Trainer::loadState(Checkpoint& checkpoint)
+  {
+  int n = network.getParameterCount();
+
+  if( checkpoint.getInt() != checkpointMagic || checkpoint.getInt() != checkpointVersion )
+    {
+    printf("error, not a checkpoint file, or from another version\n");
+    exit(1);
+    }
+
+  if( checkpoint.getInt() != mode )
+    {
+    printf("error, the checkpoint was written in another training mode\n");
+    exit(1);
+    }
+
+  if( checkpoint.getInt() != (int)originalSamples.size() )
+    {
+    printf("error, the checkpoint does not match the training samples\n");
+    exit(1);
+    }
+
+  epoch = checkpoint.getInt();
+  mse = checkpoint.getDouble();
+  oldmse = checkpoint.getDouble();
+  usageError = checkpoint.getInt();
+  usageCounted = checkpoint.getInt();
+  stalled = checkpoint.getInt();
+  gradientCount = checkpoint.getDouble();
+  elapsedTime = checkpoint.getDouble();
+
+  getSamples(checkpoint, samples);
+  getSamples(checkpoint, usageSamples);
+
+  validationMse = checkpoint.getDouble();
+  validationUsageError = checkpoint.getInt();
+  bestValidation = checkpoint.getDouble();
+  bestEpoch = checkpoint.getInt();
+
+  delete [] bestWeights;
+  bestWeights = NULL;
+
+  if( checkpoint.getInt() )
+    {
+    assert( bestWeights = new double[n] );
+    checkpoint.getDoubles(bestWeights, n);
+    }
+
+  network.loadState(checkpoint);
+
+  if( checkpoint.getInt() != (optimizer != NULL) )
+    {
+    printf("error, the checkpoint does not match the optimizer\n");
+    exit(1);
+    }
+
+  if( optimizer )
+    {
+    optimizer->loadState(checkpoint);
+    }
+
+  if( checkpoint.getInt() )
+    {
+    if( lbfgs == NULL )
+      {
+      lbfgs = new Lbfgs(n, lbfgsMemory);
+
+      assert( lbfgsWeights = new double[n] );
+      assert( lbfgsGradient = new double[n] );
+      assert( trialWeights = new double[n] );
+      assert( trialGradient = new double[n] );
+      assert( direction = new double[n] );
+      }
+
+    lbfgs->loadState(checkpoint);
+    checkpoint.getDoubles(lbfgsWeights, n);
+    checkpoint.getDoubles(lbfgsGradient, n);
+    lbfgsLoss = checkpoint.getDouble();
+    lbfgsSse = checkpoint.getDouble();
+    lbfgsUsageError = checkpoint.getInt();
+    }
+
+  if( checkpoint.getInt() )
+    {
+    delete lm;
+    lm = new LevenbergMarquardt(network, samples, checkpoint.getDouble());
+    }
+
+  if( checkpoint.getInt() != (schedule == BOLD_DRIVER) )
+    {
+    printf("error, the checkpoint does not match the learning rate schedule\n");
+    exit(1);
+    }
+
+  if( schedule == BOLD_DRIVER )
+    {
+    rate = checkpoint.getDouble();
+    rolledBack = checkpoint.getInt();
+    haveAcceptedWeights = checkpoint.getInt();
+
+    if( haveAcceptedWeights )
+      {
+      if( acceptedWeights == NULL )
+        {
+        printf("error, the checkpoint was written with --rollback\n");
+        exit(1);
+        }
+
+      checkpoint.getDoubles(acceptedWeights, n);
+      }
+    }
+  }
+
+
+/**
+ * Write the full training state to a file every so many epochs, and when
+ * training ends.  Each checkpoint is written in the background while the
+ * next epochs run, and replaces the previous one atomically.
+ */
+
+void Trainer::setCheckpoint(const char* path, int interval)
+  {
+  assert( interval > 0 );
+  checkpointPath = path;
+  checkpointInterval = interval;
+  }
+
+
+/**
+ * Continue training from a checkpoint written by a Trainer for the same
+ * network, samples and settings, exactly as if it had not been stopped.
+ * Returns false if the file cannot be read.
+ */
+
+bool Trainer::resume(const char* path)
+  {
+  Checkpoint saved;
+
+  if( !saved.read(path) )
+    {
+    return false;
+    }
+
+  loadState(saved);
+
+  started = false;
+
+  // A checkpoint written as training ended, or past this run's limits,
+  // resumes already over rather than running another epoch.
+
+  checkTermination(!validationSamples.empty());
+
+  if( reason != NONE && !usageCounted )
+    {
+    usageError = countUsageErrors();
+    usageCounted = true;
+    }
+
+  return true;
+  }
+
+
+/**
+ * Measure the mse of the weights the Network starts from, and end training
+ * before the first epoch if they already meet the goal.
+ */
+
+void Trainer::checkStartingWeights()
+  {
+  double sse = 0;
+
+  for( std::vector<Sample*>::iterator sample = samples.begin();
+       sample != samples.end();
+       sample++ )
+    {
+    network.fire(**sample);
+
+    sse += network.computeError(**sample);
+    }
+
+  if( ring )
+    {
+    ring->allReduce(&sse, 1);
+    }
+
+  if( sse/totalSamples > goal )
+    {
+    return;
+    }
+
+  mse = sse/totalSamples;
+  reason = GOAL_REACHED;
+
+  usageError = countUsageErrors();
+
+  if( ring )
+    {
+    double count = usageError;
+    ring->allReduce(&count, 1);
+    usageError = (int)count;
+    }
+
+  usageCounted = true;
+  }
+
+
+/**
+ * Decide whether training is over after the epochs run so far, setting
+ * the reason it ended.
+ */
+
+void Trainer::checkTermination(bool validating)
+  {
+  if( mse <= goal )
+    {
+    reason = GOAL_REACHED;
+    }
+  else if( epoch >= epochLimit )
+    {
+    reason = LIMIT_EXCEEDED;
+    }
+  else if( timeLimit > 0 && elapsedTime >= timeLimit )
+    {
+    reason = TIME_EXCEEDED;
+    }
+  else if( gradientLimit > 0 && gradientCount >= gradientLimit )
+    {
+    reason = BUDGET_EXCEEDED;
+    }
+  else if( stalled )
+    {
+    reason = LACK_OF_PROGRESS;
+    }
+  else if( validating && epoch - bestEpoch >= patience )
+    {
+    reason = NO_VALIDATION_PROGRESS;
+    }
+
+/* There is a problem using this with a one-hot output layer.
+  else if( oldmse == mse )
+    {
+    reason = LACK_OF_PROGRESS;
+    }
+*/
+  }
+
+
+/**
+ * Run one epoch of training and decide whether training is over.
+ */
+
+void Trainer::runEpoch()
+  {
+  int nsamples = totalSamples;
+
+  if( !started )
+    {
+    // A resumed Trainer already has its rprop and optimizer state, and
+    // counts time on from where it stopped.
+
+    if( epoch == 0 && mode == RPROP )
+      {
+      network.resetRprop(rprop);
+      }
+
+    if( epoch == 0 && optimizer )
+      {
+      network.initOptimizer(*optimizer);
+      }
+
+    startTime = lastProgressTime = getTime() - elapsedTime;
+
+    started = true;
+    }
+
+  passUsageError = 0;
+
+  scheduleRate();
+
+  double sse = (mode == MINIBATCH) ? runMinibatches()
+             : fullBatch           ? runFullBatch()
+             : (mode == LBFGS)     ? runLbfgs()
+             : (mode == LM)        ? runLevenbergMarquardt()
+             :                       runSamples();
+
+  mse = sse/nsamples;
+
+  epoch++;
+
+  if( schedule == BOLD_DRIVER )
+    {
+    adaptRate();
+    }
+
+  double now = getTime();
+
+  elapsedTime = now - startTime;
+
+  bool validating = !validationSamples.empty();
+
+  if( validating )
+    {
+    validate();
+    }
+
+  checkTermination(validating);
+
+  // The training pass has fired every sample already, so its outputs give
+  // the usage errors when they are the same as in use.  Otherwise a separate
+  // pass is made every usageInterval epochs and at the end.
+
+  usageCounted = fusedUsage || epoch%usageInterval == 0 || reason != NONE;
+
+  if( fusedUsage )
+    {
+    usageError = passUsageError;
+    }
+  else if( usageCounted )
+    {
+    usageError = countUsageErrors();
+
+    if( ring )
+      {
+      double count = usageError;
+      ring->allReduce(&count, 1);
+      usageError = (int)count;
+      }
+    }
+
+  int interval = 1;
+
+  if( Trace::atLevel(3) || (Trace::atLevel(2) && epoch%interval == 0) )
+    {
+    printf("\nend epoch %d, mse: %10.8f %s",
+          epoch,
+          mse,
+          rolledBack ? "rolled back" : mse < oldmse ? "decreasing" : "increasing");
+
+    if( schedule != CONSTANT_RATE )
+      {
+      printf(", rate: %g", rate);
+      }
+
+    if( usageCounted )
+      {
+      int usageCount = getUsageSampleCount();
+
+      printf(", usage error: %d/%d (%5.2f%%)",
+             usageError,
+             usageCount,
+             100.0*usageError/usageCount);
+      }
+
+    if( selection != SELECT_ALL )
+      {
+      printf(", backpropagated: %d/%d", backpropagated, nsamples);
+      }
+
+    if( validating )
+      {
+      printf(", validation mse: %10.8f", validationMse);
+
+      if( validateOnUsage || network.useMatchesFire() )
+        {
+        printf(", validation usage error: %d/%d",
+               validationUsageError,
+               (int)validationSamples.size());
+        }
+      }
+
+    printf("\n");
+    }
+
+  if( progressInterval > 0 && (now - lastProgressTime >= progressInterval || reason != NONE) )
+    {
+    printf("progress: epoch %d, mse %10.8f, %.1f seconds, %.0f sample gradients (%.0f per second)\n",
+           epoch,
+           mse,
+           elapsedTime,
+           gradientCount,
+           elapsedTime > 0 ? gradientCount/elapsedTime : 0);
+
+    fflush(stdout);
+
+    lastProgressTime = now;
+    }
+
+  oldmse = mse;
+
+  if( !checkpointPath.empty() && (epoch%checkpointInterval == 0 || reason != NONE) )
+    {
+    // The previous checkpoint must be on the disk before its buffer is reused.
+
+    if( !checkpoint.finishWrite() )
+      {
+      printf("warning, cannot write checkpoint %s\n", checkpointPath.c_str());
+      }
+
+    checkpoint.clear();
+
+    saveState(checkpoint);
+
+    checkpoint.startWrite(checkpointPath.c_str());
+    }
+  }
+
+
+/**
+ * Run up to count more epochs, stopping early if training is over.
+ * Returns whether it is over.
+ */
+
+bool Trainer::runEpochs(int count)
+  {
+  for( int i = 0; i < count && reason == NONE; i++ )
+    {
+    runEpoch();
+    }
+
+  return reason != NONE;
+  }
+
+
+/**
+ * Run epochs until training is over, returning the reason it ended.
+ * With validation samples, the Network is left with the best weights.
+ */
+
+TERMINATION_REASON Trainer::train()
+  {
+  while( reason == NONE )
+    {
+    runEpoch();
+    }
+
+  if( !checkpointPath.empty() && !checkpoint.finishWrite() )
+    {
+    printf("warning, cannot write checkpoint %s\n", checkpointPath.c_str());
+    }
+
+  if( bestWeights )
+    {
+    network.setWeights(bestWeights);
+    }
+
+  return reason;
+  }
+
+
+/**
+ * Get the number of epochs completed.
+ */
+
+int Trainer::getEpoch() const
+  {
+  return epoch;
+  }
+
+
+/**
+ * Get the mse of the most recent epoch.
+ */
+
+double Trainer::getMse() const
+  {
+  return mse;
+  }
+
+
+/**
+ * Get the learning rate, as the schedule has left it.
+ */
+
+double Trainer::getRate() const
+  {
+  return rate;
+  }
+
+
+/**
+ * Get the most recent usage error count, and the number of samples
+ * it was counted on.
+ */
+
+int Trainer::getUsageError() const
+  {
+  return usageError;
+  }
+
+int Trainer::getUsageSampleCount() const
+  {
+  return fusedUsage || ring ? totalSamples : usageSamples.size();
+  }
+
+
+TERMINATION_REASON Trainer::getReason() const
+  {
+  return reason;
+  }
+
+
+/**
+ * Get the wall-clock seconds spent training, to the end of the last epoch,
+ * and the number of sample gradients computed.
+ */
+
+double Trainer::getElapsedTime() const
+  {
+  return elapsedTime;
+  }
+
+double Trainer::getGradientCount() const
+  {
+  return gradientCount;
+  }
+
+
+/**
+ * Get the epoch with the best validation error, and that error: the mse,
+ * or the number of usage errors.
+ */
+
+int Trainer::getBestEpoch() const
+  {
+  return bestEpoch;
+  }
+
+double Trainer::getBestValidation() const
+  {
+  return bestValidation;
+  }
+
+
+/**
+ * destructor
+ */
+
+Trainer::~Trainer()
+  {
+  delete batch;
+  delete optimizer;
+  delete lbfgs;
+  delete lm;
+  delete [] bestWeights;
+  delete [] lbfgsWeights;
+  delete [] lbfgsGradient;
+  delete [] trialWeights;
+  delete [] trialGradient;
+  delete [] direction;
+  delete [] ringValues;
+  delete [] startWeights;
+  delete [] acceptedWeights;
+
+  for( size_t t = 0; t < parts.size(); t++ )
+    {
+    delete parts[t];
+    }
+
+  delete pool;
+  delete [] slots;
+  }
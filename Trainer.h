@@ -0,0 +1,847 @@
+// file:    Trainer.h
+// purpose: Header file for Trainer class
+
+#ifndef __Trainer__
+#define __Trainer__
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+#include "Checkpoint.h"
+#include "Lbfgs.h"
+#include "LevenbergMarquardt.h"
+#include "Network.h"
+#include "Optimizer.h"
+#include "Ring.h"
+#include "Rprop.h"
+#include "Sample.h"
+#include "ThreadPool.h"
+
+enum  MODE {ONLINE = 0, BATCH = 1, RPROP = 2, MINIBATCH = 3, LBFGS = 4, LM = 5};
+
+extern std::string modeName[];
+
+enum TERMINATION_REASON {NONE = 0,
+                         GOAL_REACHED = 1,
+                         LIMIT_EXCEEDED = 2,
+                         LACK_OF_PROGRESS = 3,
+                         NO_VALIDATION_PROGRESS = 4,
+                         TIME_EXCEEDED = 5,
+                         BUDGET_EXCEEDED = 6};
+
+extern std::string reasonName[];
+
+/**
+ * which samples are backpropagated in an epoch: all of them, those whose
+ * loss is not below a threshold, or a random choice weighted by loss
+ */
+
+enum SELECTION {SELECT_ALL = 0, SKIP_BELOW = 1, SAMPLE_BY_LOSS = 2};
+
+/**
+ * how the learning rate changes from epoch to epoch: not at all, by a
+ * factor every so many epochs, along a half cosine to 0 at the epoch limit,
+ * or up after an epoch that lowers the mse and down after one that raises it
+ */
+
+enum SCHEDULE {CONSTANT_RATE = 0, STEP_DECAY = 1, COSINE = 2, BOLD_DRIVER = 3};
+
+extern std::string scheduleName[];
+
+const int     defaultBatchSize           = 32;
+
+const int     defaultLbfgsMemory         = 10;
+
+const int     defaultPatience            = 100;
+
+const int     defaultCheckpointInterval  = 100;
+
+const int     defaultRevisitInterval     = 10;
+
+const double  defaultDecayFactor         = 0.5;
+
+const int     defaultDecayInterval       = 1000;
+
+const double  defaultGrowFactor          = 1.05;
+
+const double  defaultShrinkFactor        = 0.5;
+
+/**
+ * the least probability with which a sample is backpropagated when
+ * sampling by loss, which bounds the weight of its gradient
+ */
+
+const double  minimumSelectionProbability = 0.05;
+
+/**
+ * the most samples fired at once when computing a full-batch gradient
+ */
+
+const int     fullBatchCapacity          = 1024;
+
+/**
+ * the samples per block of a deterministic full-batch gradient, whose
+ * gradients are summed in a fixed order whatever the number of threads
+ */
+
+const int     reductionBlockSize         = 256;
+
+class GradientPart;
+
+/**
+ * A Trainer trains a Network on a set of training Samples, one epoch at
+ * a time, until the mse goal is reached or the epoch limit is exceeded.
+ *
+ * In on-line mode the weights are adjusted after every sample, in batch
+ * and rprop modes after every epoch, and in mini-batch mode after every
+ * batch of samples, taken in a freshly shuffled order each epoch.
+ * Batch and rprop modes normally also adjust the weights after each sample;
+ * with full-batch gradients they only use the gradient over all samples,
+ * computed with one matrix product per layer.
+ * In lbfgs mode each epoch is one L-BFGS iteration: a line search along the
+ * quasi-Newton direction computed from full-batch gradients.
+ * In Levenberg-Marquardt mode each epoch is one damped Gauss-Newton step.
+ *
+ * With validation samples, training also stops once their error has not
+ * improved for a number of epochs, and the best weights are restored.
+ *
+ * Training can also be limited in wall-clock time and in the number of
+ * sample gradients computed; both are checked at the end of each epoch.
+ *
+ * Full-batch gradients can be computed by several threads, each firing
+ * its own blocks of samples, optionally in a deterministic way whose
+ * results do not depend on the number of threads (see setThreads).
+ *
+ * With full-batch gradients, batch and rprop training can be spread over
+ * several processes, each with a share of the samples, which sum their
+ * gradients before each step (see setRing).
+ *
+ * In on-line mode, and in batch and rprop modes without full-batch
+ * gradients, backpropagation can be limited to the samples the network
+ * does not yet fit well (see setSelection).
+ *
+ * In the modes with a learning rate, the rate can follow a schedule
+ * (see setStepDecay, setCosine and setBoldDriver).
+ */
+
+class Trainer
+{
+private:
+
+Network& network;
+
+/**
+ * the training samples, in the order in which they are presented
+ */
+
+std::vector<Sample*> samples;
+
+/**
+ * the training samples in their original order, by which a checkpoint
+ * records the current order
+ */
+
+std::vector<Sample*> originalSamples;
+
+MODE mode;
+
+/**
+ * the learning rate in use, and the one given, from which a schedule starts
+ */
+
+double rate;
+
+double initialRate;
+
+/**
+ * the learning rate schedule, its factors and the epochs between step
+ * decays; for the bold driver with rollback, the weights at the start of
+ * the epoch and those of the last epoch accepted, whose mse is oldmse, and
+ * whether the last epoch was rolled back (see adaptRate)
+ */
+
+SCHEDULE schedule;
+
+double decayFactor;
+
+int decayInterval;
+
+double growFactor;
+
+double shrinkFactor;
+
+bool rollback;
+
+double* startWeights;
+
+double* acceptedWeights;
+
+bool haveAcceptedWeights;
+
+bool rolledBack;
+
+double goal;
+
+int epochLimit;
+
+/**
+ * the number of samples per weight update in mini-batch mode
+ */
+
+int batchSize;
+
+/**
+ * the rprop variant and constants, in rprop mode
+ */
+
+Rprop rprop;
+
+/**
+ * the Optimizer used in on-line and mini-batch modes, or NULL for
+ * plain gradient descent
+ */
+
+Optimizer* optimizer;
+
+/**
+ * whether batch and rprop modes use full-batch gradients only
+ */
+
+bool fullBatch;
+
+/**
+ * storage for firing a mini-batch, or a chunk of all the samples for a
+ * full-batch gradient, through the network, allocated on first use
+ */
+
+Batch* batch;
+
+/**
+ * in lbfgs mode: the inverse Hessian approximation, allocated on first use,
+ * the number of pairs it remembers, and the current and trial weights and
+ * gradients, with the search direction
+ */
+
+Lbfgs* lbfgs;
+
+int lbfgsMemory;
+
+double* lbfgsWeights;
+
+double* lbfgsGradient;
+
+double* trialWeights;
+
+double* trialGradient;
+
+double* direction;
+
+/**
+ * the loss and sse at lbfgsWeights
+ */
+
+double lbfgsLoss;
+
+double lbfgsSse;
+
+/**
+ * in Levenberg-Marquardt mode: the solver, allocated on first use,
+ * and its initial damping
+ */
+
+LevenbergMarquardt* lm;
+
+double mu;
+
+/**
+ * the usage errors on the last L-BFGS weights
+ */
+
+int lbfgsUsageError;
+
+/**
+ * Usage errors are counted from the outputs of the training pass when
+ * using the network gives the same outputs as firing it (fusedUsage).
+ * Otherwise they are counted by a separate pass over usageSamples,
+ * every usageInterval epochs.
+ */
+
+bool fusedUsage;
+
+int usageInterval;
+
+std::vector<Sample*> usageSamples;
+
+/**
+ * the usage errors counted during the current training pass
+ */
+
+int passUsageError;
+
+/**
+ * whether usageError was counted in the most recent epoch
+ */
+
+bool usageCounted;
+
+/**
+ * held-out samples for early stopping, the number of epochs without
+ * improvement allowed, and whether the usage error rather than the mse
+ * is watched
+ */
+
+std::vector<Sample*> validationSamples;
+
+int patience;
+
+bool validateOnUsage;
+
+/**
+ * the most recent validation mse and usage error, and the best value of the
+ * watched one, with the epoch and weights where it was reached
+ */
+
+double validationMse;
+
+int validationUsageError;
+
+double bestValidation;
+
+int bestEpoch;
+
+double* bestWeights;
+
+/**
+ * the limits on wall-clock seconds and on sample gradients, 0 for none
+ */
+
+double timeLimit;
+
+double gradientLimit;
+
+/**
+ * the seconds between progress reports, 0 for none
+ */
+
+double progressInterval;
+
+/**
+ * the wall-clock time training started and of the last progress report,
+ * the seconds elapsed by the end of the last epoch, and the number of
+ * sample gradients computed so far
+ */
+
+double startTime;
+
+double lastProgressTime;
+
+double elapsedTime;
+
+double gradientCount;
+
+/**
+ * the file periodic checkpoints are written to, if any, every
+ * checkpointInterval epochs, and the buffer being written
+ */
+
+std::string checkpointPath;
+
+int checkpointInterval;
+
+Checkpoint checkpoint;
+
+/**
+ * the selection of samples to backpropagate, its loss threshold or
+ * scale, the epochs between passes that backpropagate every sample, and
+ * the number backpropagated in the last epoch
+ */
+
+SELECTION selection;
+
+double selectionLoss;
+
+int revisitInterval;
+
+int backpropagated;
+
+/**
+ * the threads computing full-batch gradients, whether the gradients are
+ * deterministic, the pool of threads and the part of the work of each,
+ * allocated on first use, and the blocks of samples, with a slot for the
+ * sums of each
+ */
+
+int numberThreads;
+
+bool deterministic;
+
+ThreadPool* pool;
+
+std::vector<GradientPart*> parts;
+
+int numberBlocks;
+
+double* slots;
+
+/**
+ * the Ring of workers whose gradients are summed, if any, the number of
+ * samples of all of them, and space for the values summed
+ */
+
+Ring* ring;
+
+int totalSamples;
+
+double* ringValues;
+
+/**
+ * whether the first epoch, or the first since resuming, has started
+ */
+
+bool started;
+
+/**
+ * whether the last epoch failed to find any better weights
+ */
+
+bool stalled;
+
+/**
+ * the number of epochs completed
+ */
+
+int epoch;
+
+double mse;
+
+double oldmse;
+
+int usageError;
+
+TERMINATION_REASON reason;
+
+
+/**
+ * Present every sample once, one at a time, returning the sse.
+ */
+
+double runSamples();
+
+
+/**
+ * Present every sample once, in shuffled mini-batches, returning the sse.
+ */
+
+double runMinibatches();
+
+
+/**
+ * Take one batch or rprop step from the full-batch gradient, returning
+ * the sse.
+ */
+
+double runFullBatch();
+
+
+/**
+ * Take one L-BFGS step with a backtracking line search, returning the sse
+ * at the new weights.
+ */
+
+double runLbfgs();
+
+
+/**
+ * Take one Levenberg-Marquardt step, returning the sse at the new weights.
+ */
+
+double runLevenbergMarquardt();
+
+
+/**
+ * Sum the accumulated gradient, the sse and the usage errors of the
+ * training pass with those of the other workers in the Ring, returning
+ * the total sse.
+ */
+
+double reduceGradient(double sse);
+
+
+/**
+ * Fire and backpropagate every sample at the current weights, as matrix
+ * products over chunks of samples, leaving the summed gradient of the loss
+ * in the accumulation.  Returns the summed loss, and sets sse to the summed
+ * error.
+ */
+
+double computeGradient(double& sse);
+
+
+/**
+ * Compute the full-batch gradient as computeGradient does, over blocks
+ * of samples on numberThreads threads, summing the blocks' results in a
+ * fixed-shape tree.
+ */
+
+double computeGradientInParts(double& sse);
+
+
+/**
+ * Set the learning rate for the next epoch from the schedule.
+ */
+
+void scheduleRate();
+
+
+/**
+ * Adapt the learning rate of the bold driver to the mse of the epoch just
+ * run, rolling the weights back if it rose and rollback was asked for.
+ */
+
+void adaptRate();
+
+
+/**
+ * Set the network weights and compute the mean loss there and its gradient.
+ */
+
+double evaluate(const double* weights, double* gradient, double& sse);
+
+
+/**
+ * Count the usage samples on which the network disagrees when used.
+ */
+
+int countUsageErrors();
+
+
+/**
+ * Decide whether training is over after the epochs run so far, setting
+ * the reason it ended.
+ */
+
+void checkTermination(bool validating);
+
+
+/**
+ * Measure the error on the validation samples, remembering the weights
+ * if it is the best so far.
+ */
+
+void validate();
+
+
+/**
+ * Save or restore everything training depends on: the weights and
+ * per-weight state, the optimizer, the epoch and error history, the
+ * sample order and the random number states.
+ */
+
+void saveState(Checkpoint& checkpoint) const;
+
+void loadState(Checkpoint& checkpoint);
+
+
+/**
+ * Record the sample pointers in a list as their original indices, or
+ * replace them by the Samples at the indices recorded.
+ */
+
+void putSamples(Checkpoint& checkpoint, const std::vector<Sample*>& list) const;
+
+void getSamples(Checkpoint& checkpoint, std::vector<Sample*>& list);
+
+public:
+
+/**
+ * constructor
+ */
+
+Trainer(Network& _network, std::list<Sample*>& trainingSamples,
+        MODE _mode, double _rate, double _goal, int _epochLimit);
+
+
+/**
+ * Set the number of samples per weight update in mini-batch mode.
+ */
+
+void setBatchSize(int _batchSize);
+
+
+/**
+ * Set the rprop variant and constants used in rprop mode.
+ */
+
+void setRprop(const Rprop& _rprop);
+
+
+/**
+ * Make batch and rprop modes use only full-batch gradients, rather than
+ * also adjusting the weights after each sample.
+ */
+
+void setFullBatch(bool _fullBatch);
+
+
+/**
+ * Use (a copy of) an Optimizer for the weight updates in on-line
+ * or mini-batch mode.
+ */
+
+void setOptimizer(const Optimizer& _optimizer);
+
+
+/**
+ * Set the number of step and gradient change pairs remembered in lbfgs mode.
+ */
+
+void setLbfgsMemory(int _lbfgsMemory);
+
+
+/**
+ * Set the initial damping used in Levenberg-Marquardt mode.
+ */
+
+void setMu(double _mu);
+
+
+/**
+ * Count usage errors with a separate pass only every so many epochs,
+ * when they cannot be counted from the training pass.
+ */
+
+void setUsageInterval(int _usageInterval);
+
+
+/**
+ * Count usage errors with a separate pass on a random subset of this many
+ * training samples, when they cannot be counted from the training pass.
+ */
+
+void setUsageSampleSize(int size);
+
+
+/**
+ * Stop training once the error on a set of validation samples has not
+ * improved for patience epochs, and end with the weights that did best.
+ * The error watched is the usage error if onUsage, otherwise the mse.
+ */
+
+void setValidation(std::list<Sample*>& _validationSamples, int _patience, bool onUsage);
+
+
+/**
+ * Backpropagate only some of the samples in on-line mode, or in batch or
+ * rprop mode without full-batch gradients.  Every sample is still fired,
+ * so the mse is exact.
+ *
+ * SKIP_BELOW skips the samples whose loss is below loss.  SAMPLE_BY_LOSS
+ * backpropagates a sample with probability its loss over loss (at most 1,
+ * and at least minimumSelectionProbability), weighting its gradient by
+ * the inverse of that probability, so that the expected gradient is the
+ * full one.  Every revisit epochs, starting with the first, all the samples
+ * are backpropagated.
+ */
+
+void setSelection(SELECTION _selection, double loss, int revisit);
+
+
+/**
+ * Compute full-batch gradients (in batch or rprop mode with full-batch
+ * gradients, or in lbfgs mode) on a number of threads.
+ *
+ * Each thread fires blocks of samples through its own Batch, and the
+ * blocks' gradients are then summed in a fixed-shape tree.  Normally
+ * there is a block per thread, so the sums, and the training, can differ
+ * in the last bits with the number of threads.  If deterministic, the
+ * blocks have reductionBlockSize samples whatever the number of threads,
+ * so the results are the same, bit for bit, for any number of threads,
+ * one included; this costs a gradient's worth of memory per block, and
+ * smaller matrix products.
+ */
+
+void setThreads(int threads, bool _deterministic);
+
+
+/**
+ * Multiply the learning rate by factor every interval epochs.
+ */
+
+void setStepDecay(double factor, int interval);
+
+
+/**
+ * Lower the learning rate along a half cosine, from the rate given at the
+ * first epoch to 0 at the epoch limit.
+ */
+
+void setCosine();
+
+
+/**
+ * Adapt the learning rate by the "bold driver" rule: multiply it by grow
+ * after an epoch whose mse is below the one before, and by shrink after one
+ * whose mse is above it.  With rollback, an epoch that raises the mse is
+ * also undone: the weights go back to those of the last epoch accepted, and
+ * the next epoch starts from them with the smaller rate.
+ *
+ * With full-batch gradients an epoch's mse is that of the weights it
+ * starts from, so it judges the step of the epoch before; that step is
+ * the one undone.
+ */
+
+void setBoldDriver(double grow, double shrink, bool _rollback);
+
+
+/**
+ * Train in batch or rprop mode with full-batch gradients as one of the
+ * workers in a Ring, each with its own share of the samples and the same
+ * network and settings.  The gradients, errors and usage errors of all
+ * the workers are summed before each step, so they all take the same
+ * steps, as one Trainer with all the samples would.
+ *
+ * Every worker must make the same calls; validation, checkpoints and
+ * the time and gradient limits are not shared, so cannot be used.
+ */
+
+void setRing(Ring* _ring);
+
+
+/**
+ * Stop training after so many seconds of wall-clock time, or 0 for no limit.
+ */
+
+void setTimeLimit(double seconds);
+
+
+/**
+ * Stop training after so many sample gradients (one per sample and epoch
+ * in most modes), or 0 for no limit.
+ */
+
+void setGradientLimit(double gradients);
+
+
+/**
+ * Report progress on the standard output every so many seconds, or 0
+ * for no reports.
+ */
+
+void setProgressInterval(double seconds);
+
+
+/**
+ * Write the full training state to a file every so many epochs, and when
+ * training ends.  Each checkpoint is written in the background while the
+ * next epochs run, and replaces the previous one atomically.
+ */
+
+void setCheckpoint(const char* path, int interval);
+
+
+/**
+ * Continue training from a checkpoint written by a Trainer for the same
+ * network, samples and settings, exactly as if it had not been stopped.
+ * Returns false if the file cannot be read.
+ */
+
+bool resume(const char* path);
+
+
+/**
+ * Measure the mse of the weights the Network starts from, and end training
+ * before the first epoch if they already meet the goal, so that weights
+ * loaded to start from are kept rather than moved by an epoch.
+ */
+
+void checkStartingWeights();
+
+
+/**
+ * Run one epoch of training and decide whether training is over.
+ */
+
+void runEpoch();
+
+
+/**
+ * Run up to count more epochs, stopping early if training is over.
+ * Returns whether it is over.
+ */
+
+bool runEpochs(int count);
+
+
+/**
+ * Run epochs until training is over, returning the reason it ended.
+ * With validation samples, the Network is left with the best weights.
+ */
+
+TERMINATION_REASON train();
+
+
+/**
+ * Get the number of epochs completed.
+ */
+
+int getEpoch() const;
+
+
+/**
+ * Get the mse of the most recent epoch.
+ */
+
+double getMse() const;
+
+
+/**
+ * Get the learning rate, as the schedule has left it.
+ */
+
+double getRate() const;
+
+
+/**
+ * Get the most recent usage error count, and the number of samples
+ * it was counted on.
+ */
+
+int getUsageError() const;
+
+int getUsageSampleCount() const;
+
+
+TERMINATION_REASON getReason() const;
+
+
+/**
+ * Get the wall-clock seconds spent training, to the end of the last epoch,
+ * and the number of sample gradients computed.
+ */
+
+double getElapsedTime() const;
+
+double getGradientCount() const;
+
+
+/**
+ * Get the epoch with the best validation error, and that error: the mse,
+ * or the number of usage errors.
+ */
+
+int getBestEpoch() const;
+
+double getBestValidation() const;
+
+
+/**
+ * destructor
+ */
+
+~Trainer();
+
+}; // class Trainer
+
+#endif
@@ -22,6 +22,9 @@
  *
  *    Trace level (0 = no trace, 1 = some trace, etc. up to about 5)
  *
+ *    Options, following the output file, such as --batch for the number
+ *    of samples per weight update in mini-batch mode
+ *
  * The input is from standard input, in free form, as follows:
  *
  *    A single number, numberInputs, indicating the input dimension
@@ -38,24 +41,21 @@
  * as intermediate training information.
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
 
+#include "Adam.h"
 #include "helper.h"
-
-enum  MODE {ONLINE = 0, BATCH = 1, RPROP = 2};
-
-std::string modeName[] = {"on-line", "batch", "rprop"};
-
-enum TERMINATION_REASON {NONE = 0, 
-                         GOAL_REACHED = 1, 
-                         LIMIT_EXCEEDED = 2, 
-                         LACK_OF_PROGRESS = 3};
-
-std::string reasonName[] = {"", "goal reached", "limit exceeded", "lack of progress"};
+#include "Momentum.h"
+#include "RMSprop.h"
+#include "Task.h"
+#include "ThreadPool.h"
+#include "Trainer.h"
 
 const MODE     defaultMode               = ONLINE;
 
@@ -65,32 +65,9 @@ const double  defaultLearningRate        = 0.01;
 
 const int     defaultTrace               = 1;
 
-const int     minimumParameters          = 9;
-
-double getFloat(const char* str)
-  {
-  char* endptr;
-  double result = strtod(str, &endptr);
-  if( *endptr != '\0' )
-    {
-    printf("error in command: expected floating point, but found %s\n", str);
-    exit(1);
-    }
-  return result;
-  }
-
-int getInteger(const char* str)
-  {
-  char* endptr;
-  int result = strtol(str, &endptr, 0);
-  if( *endptr != '\0' )
-    {
-    printf("error in command: expected integer, but found %s\n", str);
-    exit(1);
-    }
-  return result;
-  }
+const double  warmDeltaInit              = 0.001;	// rprop's first steps from loaded weights
 
+const int     minimumParameters          = 9;
 
 void showAndCountSamples(const char* title, std::list<Sample*>& samples, int& nSamples)
   {
@@ -118,6 +95,289 @@ void showAndCountSamples(const char* title, std::list<Sample*>& samples, int& nS
   std::cout << "\n" << nSamples << " " << title << " samples" << std::endl;
   }
 
+/**
+ * A RestartRound runs some epochs of one restart's Trainer, on a thread
+ * of a ThreadPool.
+ */
+
+class RestartRound : public Task
+{
+public:
+
+Trainer* trainer;
+
+int epochs;
+
+RestartRound(Trainer* _trainer, int _epochs)
+  {
+  trainer = _trainer;
+  epochs = _epochs;
+  }
+
+void run()
+  {
+  trainer->runEpochs(epochs);
+  }
+};
+
+
+/**
+ * How well a restart is doing: its best validation error, if it has
+ * validation samples, otherwise its training mse.  Lower is better, and
+ * a restart that diverged scores infinity, worse than any other.
+ */
+
+double getScore(const Trainer& trainer, bool validating)
+  {
+  double score = validating ? trainer.getBestValidation() : trainer.getMse();
+
+  return isfinite(score) ? score : HUGE_VAL;
+  }
+
+
+/**
+ * Train the restarts in parallel until they are over, returning the index
+ * of the best.
+ *
+ * With a cull interval they run that many epochs at a time, and after each
+ * round the worse half of those still training are dropped.
+ */
+
+int trainRestarts(std::vector<Trainer*>& trainers, int cullInterval, bool validating)
+  {
+  int restarts = trainers.size();
+
+  int threads = ThreadPool::getProcessorCount();
+
+  ThreadPool pool(restarts < threads ? restarts : threads);
+
+  std::vector<int> culledAt(restarts, 0);
+
+  int round = cullInterval > 0 ? cullInterval : INT_MAX;
+
+  for( ;; )
+    {
+    std::vector<RestartRound*> tasks;
+    std::vector<int> running;
+
+    for( int r = 0; r < restarts; r++ )
+      {
+      if( culledAt[r] == 0 && trainers[r]->getReason() == NONE )
+        {
+        tasks.push_back(new RestartRound(trainers[r], round));
+        running.push_back(r);
+        pool.add(tasks.back());
+        }
+      }
+
+    if( tasks.empty() )
+      {
+      break;
+      }
+
+    pool.wait();
+
+    for( size_t k = 0; k < tasks.size(); k++ )
+      {
+      delete tasks[k];
+      }
+
+    if( cullInterval == 0 || running.size() < 2 )
+      {
+      continue;
+      }
+
+    // Keep the better half of the ones still training, rounding up.
+
+    std::vector<std::pair<double, int> > ranked;
+
+    for( size_t k = 0; k < running.size(); k++ )
+      {
+      int r = running[k];
+
+      if( trainers[r]->getReason() == NONE )
+        {
+        ranked.push_back(std::make_pair(getScore(*trainers[r], validating), r));
+        }
+      }
+
+    std::stable_sort(ranked.begin(), ranked.end());
+
+    for( size_t k = (ranked.size()+1)/2; k < ranked.size(); k++ )
+      {
+      culledAt[ranked[k].second] = trainers[ranked[k].second]->getEpoch();
+      }
+    }
+
+  int best = -1;
+
+  for( int r = 0; r < restarts; r++ )
+    {
+    if( culledAt[r] == 0
+     && (best < 0 || getScore(*trainers[r], validating) < getScore(*trainers[best], validating)) )
+      {
+      best = r;
+      }
+    }
+
+  if( Trace::atLevel(1) )
+    {
+    std::cout << std::endl;
+
+    for( int r = 0; r < restarts; r++ )
+      {
+      printf("restart %d: %s %10.8f at epoch %d, %s%s\n",
+             r+1,
+             validating ? "validation" : "mse",
+             validating ? trainers[r]->getBestValidation() : trainers[r]->getMse(),
+             trainers[r]->getEpoch(),
+             culledAt[r] ? "culled" : reasonName[trainers[r]->getReason()].c_str(),
+             r == best ? " (best)" : "");
+      }
+    }
+
+  return best;
+  }
+
+
+/**
+ * Deal the samples, in a random order, into k folds of nearly equal size.
+ * For each fold, the others make up its training samples.
+ */
+
+void makeFolds(const std::list<Sample*>& samples, int k,
+               std::vector<std::list<Sample*> >& training,
+               std::vector<std::list<Sample*> >& test, Random& random)
+  {
+  std::vector<Sample*> order(samples.begin(), samples.end());
+
+  int n = order.size();
+
+  if( n < k )
+    {
+    printf("error, %d samples cannot make %d folds\n", n, k);
+    exit(1);
+    }
+
+  for( int i = n-1; i > 0; i-- )
+    {
+    int j = (int)(random.uniform()*(i+1));
+    std::swap(order[i], order[j]);
+    }
+
+  for( int i = 0; i < n; i++ )
+    {
+    int fold = (int)((long)i*k/n);
+
+    for( int f = 0; f < k; f++ )
+      {
+      (f == fold ? test[f] : training[f]).push_back(order[i]);
+      }
+    }
+  }
+
+
+/**
+ * A FoldRun trains the network of one fold and tests it on the fold's own
+ * samples, on a thread of a ThreadPool.
+ */
+
+class FoldRun : public Task
+{
+public:
+
+Trainer* trainer;
+
+Network* network;
+
+const std::list<Sample*>* testSamples;
+
+double testMse;
+
+int usageErrors;
+
+void run()
+  {
+  trainer->train();
+
+  testMse = evaluateSamples(*testSamples, *network, usageErrors);
+  }
+};
+
+
+/**
+ * Train the folds in parallel, then show the test error of each and their
+ * mean and variance.
+ */
+
+void crossValidate(std::vector<Trainer*>& trainers, std::vector<Network*>& networks,
+                   std::vector<std::list<Sample*> >& foldTest)
+  {
+  int k = trainers.size();
+
+  int threads = ThreadPool::getProcessorCount();
+
+  std::vector<FoldRun> runs(k);
+
+    {
+    ThreadPool pool(k < threads ? k : threads);
+
+    for( int f = 0; f < k; f++ )
+      {
+      runs[f].trainer = trainers[f];
+      runs[f].network = networks[f];
+      runs[f].testSamples = &foldTest[f];
+
+      pool.add(&runs[f]);
+      }
+
+    pool.wait();
+    }
+
+  double sumMse = 0, sumSquaredMse = 0;
+  double sumUsage = 0, sumSquaredUsage = 0;
+
+  std::cout << std::endl;
+
+  for( int f = 0; f < k; f++ )
+    {
+    double usage = 100.0*runs[f].usageErrors/foldTest[f].size();
+
+    printf("fold %d: %d epochs, %s, training mse %10.8f, test mse %10.8f, "
+           "usage error %d/%d (%5.2f%%)\n",
+           f+1,
+           trainers[f]->getEpoch(),
+           reasonName[trainers[f]->getReason()].c_str(),
+           trainers[f]->getMse(),
+           runs[f].testMse,
+           runs[f].usageErrors,
+           (int)foldTest[f].size(),
+           usage);
+
+    sumMse += runs[f].testMse;
+    sumSquaredMse += runs[f].testMse*runs[f].testMse;
+    sumUsage += usage;
+    sumSquaredUsage += usage*usage;
+    }
+
+  // sample variances, over k-1
+
+  double meanMse = sumMse/k;
+  double meanUsage = sumUsage/k;
+
+  double varianceMse = (sumSquaredMse - k*meanMse*meanMse)/(k-1);
+  double varianceUsage = (sumSquaredUsage - k*meanUsage*meanUsage)/(k-1);
+
+  printf("\n%d-fold cross-validation: test mse mean %10.8f, variance %10.8f; "
+         "usage error mean %5.2f%%, variance %5.2f\n",
+         k,
+         meanMse,
+         varianceMse > 0 ? varianceMse : 0,
+         meanUsage,
+         varianceUsage > 0 ? varianceUsage : 0);
+  }
+
+
 /**
  * main program reads samples and runs training.
  */
@@ -132,6 +392,98 @@ double goal = defaultGoal;
 
 MODE mode = defaultMode;
 
+int batchSize = defaultBatchSize;
+
+bool fullBatch = false;
+
+int gradientThreads = 1;	// threads computing full-batch gradients
+
+bool deterministic = false;	// full-batch gradients independent of the threads
+
+double validationFraction = 0;	// of the training samples held out
+
+const char* validationFile = NULL;
+
+int patience = defaultPatience;
+
+bool validateOnUsage = false;
+
+double timeLimit = 0;		// seconds, 0 for none
+
+double gradientLimit = 0;	// sample gradients, 0 for none
+
+double progressInterval = 0;	// seconds between progress reports, 0 for none
+
+const char* checkpointFile = NULL;
+
+int checkpointInterval = defaultCheckpointInterval;
+
+const char* resumeFile = NULL;
+
+const char* initWeightFile = NULL;	// weights to start from, rather than random ones
+
+const char* initList = NULL;	// initialization schemes of the layers, or one for all
+
+int restarts = 1;		// networks trained from different random weights
+
+int cullInterval = 0;		// epochs between cullings of the restarts, 0 for none
+
+int folds = 0;			// for k-fold cross-validation, 0 for none
+
+uint64_t seed = defaultSeed;	// of all the random numbers
+
+const char* ringPath = NULL;	// for distributed training, the workers' socket path
+
+int rank = 0;			// of this worker, from 0
+
+int workers = 1;		// in distributed training
+
+SELECTION selection = SELECT_ALL;	// of the samples backpropagated
+
+double selectionLoss = 0;
+
+int revisitInterval = defaultRevisitInterval;
+
+int negatives = 0;		// sampled categories of a onehot output, 0 for all
+
+SCHEDULE schedule = CONSTANT_RATE;	// of the learning rate
+
+double decayFactor = defaultDecayFactor;
+
+int decayInterval = defaultDecayInterval;
+
+double growFactor = defaultGrowFactor;
+
+double shrinkFactor = defaultShrinkFactor;
+
+bool rollback = false;
+
+int usageInterval = 1;
+
+int usageSampleSize = 0;	// 0 for all training samples
+
+int lbfgsMemory = defaultLbfgsMemory;
+
+double mu = defaultMu;
+
+double lmMemoryLimit = defaultLmMemoryLimit;
+
+Rprop rprop;
+
+bool deltaInitGiven = false;
+
+std::string optimizerName = "sgd";
+
+double momentum = 0.9;		// for momentum and nesterov
+
+double beta1 = 0.9;		// for adam
+
+double beta2 = 0.999;
+
+double rho = 0.9;		// for rmsprop
+
+double epsilon = 1e-8;		// for adam and rmsprop
+
 int numberLayers;
 
 int* layerSize;	// array of layer sizes
@@ -143,10 +495,98 @@ Trace::setLevel(defaultTrace);
 if( argc <= minimumParameters )
   {
   std::cout << "parameters: <training file> <max epochs> "
-               "<learning rate> <mse goal> <mode: 0 = on-line, 1 = batch, 2 = rprop> <trace> " 
+               "<learning rate> <mse goal> <mode: 0 = on-line, 1 = batch, 2 = rprop, 3 = mini-batch, 4 = lbfgs, "
+               "5 = levenberg-marquardt> <trace> " 
                "<saved weight file> <number of layers> <layer type> <number in layer> ... "
-               "<test file> <output file>"
+               "<test file> <output file> [options]"
             << std::endl;
+  std::cout << "a first layer may be a convolution, conv:<function>:<slot width>:<kernel slots>"
+               "[:<stride>[:<pool>[:<lead inputs>]]], of that number of filters" << std::endl;
+  std::cout << "options:" << std::endl
+            << "    --batch <size>    samples per weight update in mini-batch mode (default "
+            << defaultBatchSize << ")" << std::endl
+            << "    --full-batch    batch and rprop modes use only full-batch gradients" << std::endl
+            << "    --threads <n>    threads computing full-batch gradients (default 1)"
+            << std::endl
+            << "    --deterministic    full-batch gradients the same, bit for bit, "
+               "for any number of threads" << std::endl
+            << "    --validation <fraction>    hold out a fraction of the training samples "
+               "for early stopping" << std::endl
+            << "    --validation-file <file>    samples for early stopping" << std::endl
+            << "    --patience <epochs>    epochs without validation improvement before "
+               "stopping (default " << defaultPatience << ")" << std::endl
+            << "    --validate-on <error>    validation error watched: mse (default) or usage"
+            << std::endl
+            << "    --time-limit <seconds>    stop training after this much wall-clock time"
+            << std::endl
+            << "    --gradient-limit <count>    stop training after this many sample gradients"
+            << std::endl
+            << "    --progress <seconds>    report progress this often" << std::endl
+            << "    --checkpoint <file>    save the training state to this file" << std::endl
+            << "    --checkpoint-every <epochs>    epochs between checkpoints (default "
+            << defaultCheckpointInterval << ")" << std::endl
+            << "    --resume <file>    continue training from a checkpoint" << std::endl
+            << "    --init-weights <file>    start from the weights saved by an earlier run"
+            << std::endl
+            << "    --init <schemes>    random weights by uniform (default), nguyen-widrow, "
+               "xavier or he, for all layers or a comma-separated scheme per layer" << std::endl
+            << "    --restarts <n>    train n networks from different random weights in "
+               "parallel, keeping the best" << std::endl
+            << "    --cull-every <epochs>    drop the worse half of the restarts this often"
+            << std::endl
+            << "    --folds <k>    cross-validate on k folds of the training samples "
+               "in parallel, instead of training" << std::endl
+            << "    --distributed <path>    train as one of several worker processes, "
+               "summing gradients over sockets <path>.<rank> (batch or rprop, full-batch)"
+            << std::endl
+            << "    --workers <n>    the number of workers" << std::endl
+            << "    --rank <r>    this worker's rank, from 0 (which saves the results)"
+            << std::endl
+            << "    --seed <n>    seed of the random weights and sample orders (default "
+            << defaultSeed << ")" << std::endl
+            << "    --skip-below <loss>    backpropagate only the samples whose loss "
+               "is at least this" << std::endl
+            << "    --sample-by-loss <loss>    backpropagate samples with probability "
+               "their loss over this, weighted to keep the gradient unbiased" << std::endl
+            << "    --revisit-every <epochs>    backpropagate all samples this often when "
+               "selecting (default " << defaultRevisitInterval << ")" << std::endl
+            << "    --negatives <count>    backpropagate a onehot output through the "
+               "desired and chosen categories and this many others drawn at random"
+            << std::endl
+            << "    --step-decay <factor>    multiply the learning rate by this every "
+               "--decay-every epochs (default " << defaultDecayInterval << ")" << std::endl
+            << "    --cosine    lower the learning rate along a half cosine to 0 at the "
+               "epoch limit" << std::endl
+            << "    --bold-driver    raise the learning rate by --grow (default "
+            << defaultGrowFactor << ") after an epoch that lowers the mse, cut it by "
+               "--shrink (default " << defaultShrinkFactor << ") after one that raises it"
+            << std::endl
+            << "    --rollback    with --bold-driver, also undo an epoch that raises the mse"
+            << std::endl
+            << "    --usage-every <epochs>    count usage errors every so many epochs, "
+               "when not counted in training (default 1)" << std::endl
+            << "    --usage-sample <samples>    count usage errors on a random subset, "
+               "when not counted in training" << std::endl
+            << "    --memory <pairs>    lbfgs remembered steps (default "
+            << defaultLbfgsMemory << ")" << std::endl
+            << "    --mu <damping>    levenberg-marquardt initial damping (default "
+            << defaultMu << ")" << std::endl
+            << "    --lm-memory <megabytes>    levenberg-marquardt memory limit (default "
+            << defaultLmMemoryLimit << ")" << std::endl
+            << "    --rprop <variant>    rprop variant: irprop- (default) or irprop+" << std::endl
+            << "    --eta-plus <factor>    rprop step size growth (default 1.2)" << std::endl
+            << "    --eta-minus <factor>    rprop step size shrinkage (default 0.5)" << std::endl
+            << "    --delta-max <step>    rprop largest step size (default 50)" << std::endl
+            << "    --delta-min <step>    rprop smallest step size (default 1e-6)" << std::endl
+            << "    --delta-init <step>    rprop initial step size (default 0.1, or 0.001 "
+               "with --init-weights)" << std::endl
+            << "    --optimizer <name>    on-line and mini-batch updates: sgd (default), "
+               "momentum, nesterov, adam or rmsprop" << std::endl
+            << "    --momentum <factor>    momentum and nesterov velocity decay (default 0.9)" << std::endl
+            << "    --beta1 <factor>    adam first moment decay (default 0.9)" << std::endl
+            << "    --beta2 <factor>    adam second moment decay (default 0.999)" << std::endl
+            << "    --rho <factor>    rmsprop mean square decay (default 0.9)" << std::endl
+            << "    --epsilon <value>    adam and rmsprop denominator offset (default 1e-8)" << std::endl;
   exit(0);
   }
 
@@ -164,9 +604,9 @@ goal = getFloat(argv[4]);
 
 int modeInt = getInteger(argv[5]);
 
-if( modeInt < 0 || modeInt > 2 )
+if( modeInt < 0 || modeInt > 5 )
   {
-  printf("mode must be 0, 1, or 2\n");
+  printf("mode must be 0, 1, 2, 3, 4, or 5\n");
   exit(1);
   }
 
@@ -176,16 +616,10 @@ Trace::setLevel(getInteger(argv[6]));
 
 char* weightFile = argv[7];
 
-std::ofstream weightStream(weightFile);
+// The weights are written when training ends, so the file can also be
+// the one --init-weights reads.
 
-if( weightStream )
-  {
-  printf("Weights will be saved in: %s\n", weightFile);
-  }
-else
-  {
-  printf("Could not create weight file: %s\n", weightFile);
-  }
+printf("Weights will be saved in: %s\n", weightFile);
 
 numberLayers = getInteger(argv[8]);
 
@@ -226,7 +660,8 @@ if( Trace::atLevel(1) )
     {
     std::cout << "    " << layerType[i]->getName() 
               << " (" << layerSize[i] << " "
-              << (layerType[i]->getName() == "onehot" ? "categories" : "neurons")
+              << (isCategorical(layerType[i]) ? "categories"
+                  : isConvolution(layerType[i]) ? "filters" : "neurons")
               << ")" << std::endl;
     }
 
@@ -276,40 +711,657 @@ else
   exit(1);
   }
 
-int inputDimension;		     // dimension of input
-int outputDimension;		     // dimension of output
+// Optional parameters follow the output file.
 
-std::list<Sample*> trainingSamples;  // list of pointers to training samples
+for( int i = parametersNeeded+2; i < argc; i++ )
+  {
+  std::string option = argv[i];
 
-getSamples(trainingFile, outputDimension, inputDimension, trainingSamples);
+  if( option == "--batch" )
+    {
+    batchSize = getInteger(getOptionValue(argc, argv, i));
 
-int nTrainingSamples = 0;
+    if( batchSize < 1 )
+      {
+      printf("batch size must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--full-batch" )
+    {
+    fullBatch = true;
+    }
+  else if( option == "--threads" )
+    {
+    gradientThreads = getInteger(getOptionValue(argc, argv, i));
 
-showAndCountSamples("training", trainingSamples, nTrainingSamples);
+    if( gradientThreads < 1 )
+      {
+      printf("threads must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--deterministic" )
+    {
+    deterministic = true;
+    }
+  else if( option == "--validation" )
+    {
+    validationFraction = getFloat(getOptionValue(argc, argv, i));
 
+    if( !(validationFraction > 0 && validationFraction < 1) )
+      {
+      printf("validation fraction must be between 0 and 1\n");
+      exit(1);
+      }
+    }
+  else if( option == "--validation-file" )
+    {
+    validationFile = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--patience" )
+    {
+    patience = getInteger(getOptionValue(argc, argv, i));
 
-int inputDimension2;		     // dimension of input
-int outputDimension2;		     // dimension of output
+    if( patience < 1 )
+      {
+      printf("patience must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--validate-on" )
+    {
+    std::string measure = getOptionValue(argc, argv, i);
 
-std::list<Sample*> testSamples;      // list of pointers to test samples
+    if( measure != "mse" && measure != "usage" )
+      {
+      printf("validation error must be mse or usage\n");
+      exit(1);
+      }
 
-getSamples(testFile, outputDimension2, inputDimension2, testSamples);
+    validateOnUsage = (measure == "usage");
+    }
+  else if( option == "--time-limit" )
+    {
+    timeLimit = getFloat(getOptionValue(argc, argv, i));
 
-if( inputDimension2 != inputDimension || outputDimension2 != outputDimension )
-  {
-  printf("error, the dimensions of the test vs. training file don't match");
-  exit(1);
-  }
+    if( !(timeLimit > 0) )
+      {
+      printf("time limit must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--gradient-limit" )
+    {
+    gradientLimit = getFloat(getOptionValue(argc, argv, i));
 
-int nTestSamples = 0;
+    if( !(gradientLimit > 0) )
+      {
+      printf("gradient limit must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--progress" )
+    {
+    progressInterval = getFloat(getOptionValue(argc, argv, i));
+
+    if( !(progressInterval > 0) )
+      {
+      printf("progress interval must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--checkpoint" )
+    {
+    checkpointFile = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--checkpoint-every" )
+    {
+    checkpointInterval = getInteger(getOptionValue(argc, argv, i));
+
+    if( checkpointInterval < 1 )
+      {
+      printf("checkpoint interval must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--resume" )
+    {
+    resumeFile = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--init-weights" )
+    {
+    initWeightFile = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--init" )
+    {
+    initList = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--restarts" )
+    {
+    restarts = getInteger(getOptionValue(argc, argv, i));
+
+    if( restarts < 1 )
+      {
+      printf("the number of restarts must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--folds" )
+    {
+    folds = getInteger(getOptionValue(argc, argv, i));
+
+    if( folds < 2 )
+      {
+      printf("there must be at least 2 folds\n");
+      exit(1);
+      }
+    }
+  else if( option == "--distributed" )
+    {
+    ringPath = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--workers" )
+    {
+    workers = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--rank" )
+    {
+    rank = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--seed" )
+    {
+    seed = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--cull-every" )
+    {
+    cullInterval = getInteger(getOptionValue(argc, argv, i));
+
+    if( cullInterval < 1 )
+      {
+      printf("cull interval must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--skip-below" || option == "--sample-by-loss" )
+    {
+    selection = option == "--skip-below" ? SKIP_BELOW : SAMPLE_BY_LOSS;
+    selectionLoss = getFloat(getOptionValue(argc, argv, i));
+
+    if( !(selectionLoss > 0) )
+      {
+      printf("the selection loss must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--revisit-every" )
+    {
+    revisitInterval = getInteger(getOptionValue(argc, argv, i));
+
+    if( revisitInterval < 1 )
+      {
+      printf("revisit interval must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--negatives" )
+    {
+    negatives = getInteger(getOptionValue(argc, argv, i));
+
+    if( negatives < 1 )
+      {
+      printf("the number of negatives must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--step-decay" )
+    {
+    schedule = STEP_DECAY;
+    decayFactor = getFloat(getOptionValue(argc, argv, i));
+
+    if( !(decayFactor > 0 && decayFactor < 1) )
+      {
+      printf("the decay factor must be between 0 and 1\n");
+      exit(1);
+      }
+    }
+  else if( option == "--decay-every" )
+    {
+    decayInterval = getInteger(getOptionValue(argc, argv, i));
+
+    if( decayInterval < 1 )
+      {
+      printf("decay interval must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--cosine" )
+    {
+    schedule = COSINE;
+    }
+  else if( option == "--bold-driver" )
+    {
+    schedule = BOLD_DRIVER;
+    }
+  else if( option == "--grow" )
+    {
+    growFactor = getFloat(getOptionValue(argc, argv, i));
+
+    if( !(growFactor >= 1) )
+      {
+      printf("the grow factor must be at least 1\n");
+      exit(1);
+      }
+    }
+  else if( option == "--shrink" )
+    {
+    shrinkFactor = getFloat(getOptionValue(argc, argv, i));
+
+    if( !(shrinkFactor > 0 && shrinkFactor < 1) )
+      {
+      printf("the shrink factor must be between 0 and 1\n");
+      exit(1);
+      }
+    }
+  else if( option == "--rollback" )
+    {
+    rollback = true;
+    }
+  else if( option == "--usage-every" )
+    {
+    usageInterval = getInteger(getOptionValue(argc, argv, i));
+
+    if( usageInterval < 1 )
+      {
+      printf("usage interval must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--usage-sample" )
+    {
+    usageSampleSize = getInteger(getOptionValue(argc, argv, i));
+
+    if( usageSampleSize < 1 )
+      {
+      printf("usage sample size must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--memory" )
+    {
+    lbfgsMemory = getInteger(getOptionValue(argc, argv, i));
+
+    if( lbfgsMemory < 1 )
+      {
+      printf("lbfgs memory must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--mu" )
+    {
+    mu = getFloat(getOptionValue(argc, argv, i));
+
+    if( !(mu > 0) )
+      {
+      printf("mu must be positive\n");
+      exit(1);
+      }
+    }
+  else if( option == "--lm-memory" )
+    {
+    lmMemoryLimit = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--rprop" )
+    {
+    RPROP_VARIANT variant;
+
+    if( !Rprop::parseVariant(getOptionValue(argc, argv, i), variant) )
+      {
+      printf("rprop variant must be irprop- or irprop+\n");
+      exit(1);
+      }
+
+    rprop.setVariant(variant);
+    }
+  else if( option == "--eta-plus" )
+    {
+    rprop.setEtaPlus(getFloat(getOptionValue(argc, argv, i)));
+    }
+  else if( option == "--eta-minus" )
+    {
+    rprop.setEtaMinus(getFloat(getOptionValue(argc, argv, i)));
+    }
+  else if( option == "--delta-max" )
+    {
+    rprop.setDeltaMax(getFloat(getOptionValue(argc, argv, i)));
+    }
+  else if( option == "--delta-min" )
+    {
+    rprop.setDeltaMin(getFloat(getOptionValue(argc, argv, i)));
+    }
+  else if( option == "--delta-init" )
+    {
+    rprop.setDeltaInit(getFloat(getOptionValue(argc, argv, i)));
+    deltaInitGiven = true;
+    }
+  else if( option == "--optimizer" )
+    {
+    optimizerName = getOptionValue(argc, argv, i);
+    }
+  else if( option == "--momentum" )
+    {
+    momentum = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--beta1" )
+    {
+    beta1 = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--beta2" )
+    {
+    beta2 = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--rho" )
+    {
+    rho = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--epsilon" )
+    {
+    epsilon = getFloat(getOptionValue(argc, argv, i));
+    }
+  else
+    {
+    printf("error in command: unrecognized option %s\n", argv[i]);
+    exit(1);
+    }
+  }
+
+Optimizer* optimizer = NULL;
+
+if( optimizerName == "momentum" )      optimizer = new Momentum(momentum, false);
+else if( optimizerName == "nesterov" ) optimizer = new Momentum(momentum, true);
+else if( optimizerName == "adam" )     optimizer = new Adam(beta1, beta2, epsilon);
+else if( optimizerName == "rmsprop" )  optimizer = new RMSprop(rho, epsilon);
+else if( optimizerName != "sgd" )
+  {
+  printf("optimizer must be sgd, momentum, nesterov, adam, or rmsprop\n");
+  exit(1);
+  }
+
+if( optimizer && mode != ONLINE && mode != MINIBATCH )
+  {
+  printf("an optimizer can only be used in on-line or mini-batch mode\n");
+  exit(1);
+  }
+
+if( fullBatch && mode != BATCH && mode != RPROP )
+  {
+  printf("--full-batch can only be used in batch or rprop mode\n");
+  exit(1);
+  }
+
+if( (gradientThreads > 1 || deterministic) && !((mode == BATCH || mode == RPROP) && fullBatch)
+ && mode != LBFGS )
+  {
+  printf("--threads and --deterministic can only be used with full-batch gradients: "
+         "in batch or rprop mode with --full-batch, or in lbfgs mode\n");
+  exit(1);
+  }
+
+if( negatives > 0 && !(mode == ONLINE || ((mode == BATCH || mode == RPROP) && !fullBatch)) )
+  {
+  printf("--negatives can only be used in on-line mode, "
+         "or in batch or rprop mode without --full-batch\n");
+  exit(1);
+  }
+
+if( negatives > 0 && layerType[numberLayers-1]->getName() != "onehot" )
+  {
+  printf("--negatives needs a onehot output layer\n");
+  exit(1);
+  }
+
+if( schedule != CONSTANT_RATE && mode != ONLINE && mode != BATCH && mode != MINIBATCH )
+  {
+  printf("a learning rate schedule can only be used in on-line, batch or mini-batch mode\n");
+  exit(1);
+  }
+
+if( rollback && schedule != BOLD_DRIVER )
+  {
+  printf("--rollback can only be used with --bold-driver\n");
+  exit(1);
+  }
+
+if( rollback && optimizer )
+  {
+  printf("--rollback cannot be used with an optimizer, whose state it would not undo\n");
+  exit(1);
+  }
+
+if( selection != SELECT_ALL && !(mode == ONLINE || ((mode == BATCH || mode == RPROP) && !fullBatch)) )
+  {
+  printf("selective backpropagation can only be used in on-line mode, "
+         "or in batch or rprop mode without --full-batch\n");
+  exit(1);
+  }
+
+if( restarts > 1 && (checkpointFile || resumeFile || initWeightFile) )
+  {
+  printf("--restarts cannot be used with checkpoints or initial weights\n");
+  exit(1);
+  }
+
+if( folds > 0 && (restarts > 1 || checkpointFile || resumeFile || initWeightFile) )
+  {
+  printf("--folds cannot be used with restarts, checkpoints or initial weights\n");
+  exit(1);
+  }
+
+if( ringPath )
+  {
+  if( workers < 1 || rank < 0 || rank >= workers )
+    {
+    printf("--distributed needs --workers <n> and a --rank from 0 to n-1\n");
+    exit(1);
+    }
+
+  if( !fullBatch || (mode != BATCH && mode != RPROP) )
+    {
+    printf("--distributed needs batch or rprop mode with --full-batch\n");
+    exit(1);
+    }
+
+  if( restarts > 1 || folds > 0 || checkpointFile || resumeFile
+   || validationFile || validationFraction > 0 || usageSampleSize > 0
+   || timeLimit > 0 || gradientLimit > 0 )
+    {
+    printf("--distributed cannot be used with restarts, folds, checkpoints, validation, "
+           "usage samples or limits other than epochs\n");
+    exit(1);
+    }
+  }
+
+INIT* initSchemes = NULL;	// of each layer
+
+if( initList )
+  {
+  std::vector<std::string> names = split(initList, ',');
+
+  if( names.size() != 1 && (int)names.size() != numberLayers )
+    {
+    printf("--init needs one scheme, or one for each of the %d layers\n", numberLayers);
+    exit(1);
+    }
+
+  initSchemes = new INIT[numberLayers];
+
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    initSchemes[i] = getInitScheme(names[names.size() == 1 ? 0 : i]);
+    }
+
+  if( Trace::atLevel(1) )
+    {
+    std::cout << "weight initialization =";
+
+    for( int i = 0; i < numberLayers; i++ )
+      {
+      std::cout << " " << initName[initSchemes[i]];
+      }
+
+    std::cout << std::endl;
+    }
+  }
+
+if( Trace::atLevel(1) && (mode == ONLINE || mode == MINIBATCH) )
+  {
+  std::cout << "optimizer = " << optimizerName << std::endl;
+  }
+
+if( Trace::atLevel(1) && mode == MINIBATCH )
+  {
+  std::cout << "batch size = " << batchSize << std::endl;
+  }
+
+if( Trace::atLevel(1) && negatives > 0 )
+  {
+  std::cout << "sampled negative categories = " << negatives << std::endl;
+  }
+
+if( Trace::atLevel(1) && schedule != CONSTANT_RATE )
+  {
+  std::cout << "learning rate schedule = " << scheduleName[schedule];
+
+  if( schedule == STEP_DECAY )
+    {
+    std::cout << ", by " << decayFactor << " every " << decayInterval << " epochs";
+    }
+  else if( schedule == BOLD_DRIVER )
+    {
+    std::cout << ", grow " << growFactor << ", shrink " << shrinkFactor
+              << (rollback ? ", with rollback" : "");
+    }
+
+  std::cout << std::endl;
+  }
+
+if( Trace::atLevel(1) && (gradientThreads > 1 || deterministic) )
+  {
+  std::cout << "gradient threads = " << gradientThreads
+            << (deterministic ? ", deterministic" : "") << std::endl;
+  }
+
+if( Trace::atLevel(1) && mode == LBFGS )
+  {
+  std::cout << "lbfgs memory = " << lbfgsMemory << std::endl;
+  }
+
+if( Trace::atLevel(1) && mode == LM )
+  {
+  std::cout << "initial mu = " << mu << std::endl;
+  }
+
+if( Trace::atLevel(1) && mode == RPROP )
+  {
+  std::cout << "rprop variant = " << rprop.getVariantName() << std::endl;
+  }
+
+int inputDimension;		     // dimension of input
+int outputDimension;		     // dimension of output
+
+std::list<Sample*> trainingSamples;  // list of pointers to training samples
+
+getSamples(trainingFile, outputDimension, inputDimension, trainingSamples);
+
+std::list<Sample*> validationSamples;  // held out for early stopping
+
+Random sampleRandom(seed, 0);	     // for choosing samples; each network has its own stream
+
+if( validationFile )
+  {
+  int inputDimension3;
+  int outputDimension3;
+
+  getSamples(validationFile, outputDimension3, inputDimension3, validationSamples);
+
+  if( inputDimension3 != inputDimension || outputDimension3 != outputDimension )
+    {
+    printf("error, the dimensions of the validation vs. training file don't match\n");
+    exit(1);
+    }
+  }
+else if( validationFraction > 0 )
+  {
+  splitSamples(trainingSamples, validationFraction, validationSamples, sampleRandom);
+  }
+
+if( (validationFile || validationFraction > 0)
+ && (validationSamples.empty() || trainingSamples.empty()) )
+  {
+  printf("error, neither the training nor the validation samples may be empty\n");
+  exit(1);
+  }
+
+// In distributed training, worker r keeps every nth sample from the rth.
+
+if( ringPath )
+  {
+  int index = 0;
+
+  for( std::list<Sample*>::iterator s = trainingSamples.begin(); s != trainingSamples.end(); index++ )
+    {
+    if( index%workers == rank )
+      {
+      s++;
+      }
+    else
+      {
+      delete *s;
+      s = trainingSamples.erase(s);
+      }
+    }
+
+  if( Trace::atLevel(1) )
+    {
+    printf("worker %d of %d, training on %d of %d samples\n",
+           rank, workers, (int)trainingSamples.size(), index);
+    }
+  }
+
+int nTrainingSamples = 0;
+
+showAndCountSamples("training", trainingSamples, nTrainingSamples);
+
+if( !validationSamples.empty() )
+  {
+  int nValidationSamples = 0;
+
+  showAndCountSamples("validation", validationSamples, nValidationSamples);
+  }
+
+
+int inputDimension2;		     // dimension of input
+int outputDimension2;		     // dimension of output
+
+std::list<Sample*> testSamples;      // list of pointers to test samples
+
+getSamples(testFile, outputDimension2, inputDimension2, testSamples);
+
+if( inputDimension2 != inputDimension || outputDimension2 != outputDimension )
+  {
+  printf("error, the dimensions of the test vs. training file don't match");
+  exit(1);
+  }
+
+int nTestSamples = 0;
 
 showAndCountSamples("test", testSamples, nTestSamples);
 
 
-// If the output is one-hot, then the output dimension should be 1 and
+// If the output is one-hot or softmax, then the output dimension should be 1 and
 // and the number of neurons parameter is interpreted as the number of categories.
 
-bool onehotOutput = (layerType[numberLayers-1]->getName()) == "onehot";
+bool onehotOutput = isCategorical(layerType[numberLayers-1]);
 
 int lastLayerSize = layerSize[numberLayers-1];
 
@@ -324,11 +1376,13 @@ if(  (!onehotOutput && (outputDimension != lastLayerSize))
   }
 
 std::cout << "\nOutput dimension is " << outputDimension 
-          << (onehotOutput ? " (one-hot)" : "")
+          << (onehotOutput ? " (" + layerType[numberLayers-1]->getName() + ")" : "")
           << "." << std::endl;
 
 std::cout << "\nInput dimension is " << inputDimension << "." << std::endl;
 
+checkConvolution(numberLayers, layerType, inputDimension);
+
 // Show and count the samples.
 
 std::list<Sample*>::iterator sample = trainingSamples.begin();
@@ -351,188 +1405,320 @@ while( sample != trainingSamples.end() )
   }
 
 
-Network network(numberLayers, layerSize, layerType, inputDimension);
+Network network(numberLayers, layerSize, layerType, inputDimension, Random(seed, 1));
 
-if( Trace::atLevel(4) ) 
+if( initSchemes )
   {
-  std::cout << "\nInitial Weights:" << std::endl;
+  network.initWeights(initSchemes);
+  }
 
-  network.showWeights("initial");
+if( mode == LM && layerType[numberLayers-1]->getName() == "softmax" )
+  {
+  printf("levenberg-marquardt needs a squared-error output layer, not softmax\n");
+  exit(1);
   }
 
-if( Trace::atLevel(1) ) std::cout << "\nTraining begins with epoch 1." << std::endl;
+if( mode == LM )
+  {
+  double megabytes = (folds > 0 ? folds : restarts)
+                   * LevenbergMarquardt::getMegabytesNeeded(network, nsamples);
+
+  if( megabytes > lmMemoryLimit )
+    {
+    printf("levenberg-marquardt needs %.0f megabytes for %d weights and %d samples, "
+           "more than the limit of %.0f (see --lm-memory)\n",
+           megabytes, network.getParameterCount(), nsamples, lmMemoryLimit);
+    exit(1);
+    }
 
-int epoch = 1;
+  if( Trace::atLevel(1) )
+    {
+    printf("levenberg-marquardt uses %.0f megabytes\n", megabytes);
+    }
+  }
+
+if( initWeightFile )
+  {
+  if( !loadWeightFile(initWeightFile, network) )
+    {
+    exit(1);
+    }
 
-int signAgreement;
+  if( Trace::atLevel(1) )
+    {
+    std::cout << "\nInitial weights loaded from " << initWeightFile << "." << std::endl;
+    }
 
-double sse;
+  // Weights already trained need small steps, not the ones random weights start with.
 
-double mse = 1+goal;
-double oldmse = 2+goal;
+  if( !deltaInitGiven )
+    {
+    rprop.setDeltaInit(warmDeltaInit);
+    }
+  }
 
-double etaPlus = 1.2;	// for rprop
-double etaMinus = 0.5;	
+if( Trace::atLevel(4) ) 
+  {
+  std::cout << "\nInitial Weights:" << std::endl;
 
-TERMINATION_REASON reason = NONE;
+  network.showWeights("initial");
+  }
 
-// The total number of output values across all samples and network outputs
+if( Trace::atLevel(1) ) std::cout << "\nTraining begins with epoch 1." << std::endl;
 
-int interval = 1;
+// With cross-validation, each fold's samples are tested on by a network
+// trained on all the others.
 
-// Training loop
+std::vector<std::list<Sample*> > foldTraining(folds);
+std::vector<std::list<Sample*> > foldTest(folds);
 
-while( reason == NONE )
+if( folds > 0 )
   {
-  sse = 0;
-  signAgreement = 0;
+  makeFolds(trainingSamples, folds, foldTraining, foldTest, sampleRandom);
+  }
 
-  switch( mode )
-    {
-    case RPROP:
-    case BATCH:
-      network.clearAccumulation();
-    case ONLINE:
-      ;
-    }
+// The restarts or folds after the first get their own networks, each with
+// its own stream of random numbers.
 
-  for( std::list<Sample*>::iterator sample = trainingSamples.begin();
-       sample != trainingSamples.end();
-       sample++ 
-     )
-    {
-    // forward propagation
+int numberTrainers = folds > 0 ? folds : restarts;
 
-    network.fire(**sample);
+std::vector<Network*> networks(1, &network);
 
-    double sampleSSE = network.computeError(**sample);
+for( int r = 1; r < numberTrainers; r++ )
+  {
+  networks.push_back(new Network(numberLayers, layerSize, layerType, inputDimension,
+                                 Random(seed, r+1)));
 
-    sse += sampleSSE;
+  if( initSchemes )
+    {
+    networks[r]->initWeights(initSchemes);
+    }
+  }
 
-    if( Trace::atLevel(4) )
-      {
-      printf("\nforward output: ");
-      network.showOutput();
+std::vector<Trainer*> trainers;
 
-      (*sample)->show();
+for( int r = 0; r < numberTrainers; r++ )
+  {
+  std::list<Sample*>& samples = folds > 0 ? foldTraining[r] : trainingSamples;
 
-      printf(", sample sse: % 6.3f\n", sampleSSE);
-      }
+  Trainer* trainer = new Trainer(*networks[r], samples, mode, rate, goal, epochLimit);
 
-    // backpropagation
+  trainer->setBatchSize(batchSize);
 
-    network.setSensitivity(**sample);
+  trainer->setRprop(rprop);
 
-      switch( mode )
-	{
-	case RPROP:
-          network.accumulateGradient(**sample);
-	case BATCH:
-          network.accumulateWeights(**sample, rate);
-	case ONLINE:
-          network.adjustWeights(**sample, rate);
-	}
+  trainer->setFullBatch(fullBatch);
 
-    if( Trace::atLevel(4) )
-      {
-      network.showWeights("current");
-      }
+  if( gradientThreads > 1 || deterministic )
+    {
+    trainer->setThreads(gradientThreads, deterministic);
     }
 
-  switch( mode )
+  if( selection != SELECT_ALL )
     {
-    case RPROP:
-      network.adjustByRprop(etaPlus, etaMinus);
+    trainer->setSelection(selection, selectionLoss, revisitInterval);
+    }
 
-    case BATCH:
-      network.installAccumulation();
+  if( schedule == STEP_DECAY )
+    {
+    trainer->setStepDecay(decayFactor, decayInterval);
+    }
+  else if( schedule == COSINE )
+    {
+    trainer->setCosine();
+    }
+  else if( schedule == BOLD_DRIVER )
+    {
+    trainer->setBoldDriver(growFactor, shrinkFactor, rollback);
+    }
 
-    case ONLINE:
-      ;
+  if( negatives > 0 )
+    {
+    networks[r]->setNegativeSamples(negatives);
     }
 
-  mse = sse/nsamples;
+  trainer->setUsageInterval(usageInterval);
 
-  double usageError = 0;
+  trainer->setTimeLimit(timeLimit);
 
-  for( std::list<Sample*>::iterator sample = trainingSamples.begin();
-       sample != trainingSamples.end();
-       sample++)
-    {
-    // evaluation with "use"
+  trainer->setGradientLimit(gradientLimit);
 
-    network.use(**sample);
+  trainer->setProgressInterval(progressInterval);
 
-    usageError += (network.computeUsageError(**sample) != 0);
+  if( !validationSamples.empty() )
+    {
+    trainer->setValidation(validationSamples, patience, validateOnUsage);
     }
 
-  if( Trace::atLevel(3) || (Trace::atLevel(2) && epoch%interval == 0) )
+  if( usageSampleSize > 0 )
     {
-    printf("\nend epoch %d, mse: %10.8f %s, usage error: %d/%d (%5.2f%%)\n",
-          epoch, 
-          mse, 
-          mse < oldmse ? "decreasing" : "increasing",
-          (int)usageError,
-          nsamples,
-          100*usageError/nsamples);
+    trainer->setUsageSampleSize(usageSampleSize);
     }
 
-  epoch++;
+  trainer->setLbfgsMemory(lbfgsMemory);
+
+  trainer->setMu(mu);
 
-  if( mse <= goal )
+  if( optimizer )
     {
-    reason = GOAL_REACHED;
+    trainer->setOptimizer(*optimizer);
     }
-  else if( epoch > epochLimit )
+
+  trainers.push_back(trainer);
+  }
+
+if( checkpointFile )
+  {
+  trainers[0]->setCheckpoint(checkpointFile, checkpointInterval);
+  }
+
+Ring* ring = NULL;
+
+if( ringPath )
+  {
+  ring = new Ring(ringPath, rank, workers);
+
+  trainers[0]->setRing(ring);
+  }
+
+if( resumeFile )
+  {
+  if( !trainers[0]->resume(resumeFile) )
+    {
+    printf("error, cannot read checkpoint %s\n", resumeFile);
+    exit(1);
+    }
+
+  if( Trace::atLevel(1) )
     {
-    reason = LIMIT_EXCEEDED;
+    std::cout << "Resuming after epoch " << trainers[0]->getEpoch() << "." << std::endl;
     }
+  }
+else if( initWeightFile )
+  {
+  trainers[0]->checkStartingWeights();
+  }
+
+double startTime = getTime();
+
+// The gradients computed in this run, by every restart, give its speed.
+
+double startGradients = trainers[0]->getGradientCount();	// resumed from
+
+if( folds > 0 )
+  {
+  crossValidate(trainers, networks, foldTest);
+
+  std::cout << "\nCross-validation took " << getTime() - startTime << " seconds." << std::endl;
+
+  exit(0);
+  }
+
+int best = (restarts == 1) ? 0 : trainRestarts(trainers, cullInterval, !validationSamples.empty());
+
+Trainer& trainer = *trainers[best];
+
+TERMINATION_REASON reason = trainer.train();
+
+if( best != 0 )
+  {
+  // Keep the best restart's weights in the network saved and tested.
+
+  std::vector<double> weights(network.getParameterCount());
+
+  networks[best]->getWeights(&weights[0]);
+
+  network.setWeights(&weights[0]);
+  }
+
+double trainingTime = getTime() - startTime;
+
+double gradients = -startGradients;
+
+for( int r = 0; r < (int)trainers.size(); r++ )
+  {
+  gradients += trainers[r]->getGradientCount();
+  }
+
+if( ring && rank != 0 )
+  {
+  // Every worker ends with the same weights; worker 0 saves and tests them.
 
-/* There is a problem using this with a one-hot output layer.
-  else if( oldmse == mse )
+  if( Trace::atLevel(1) )
     {
-    reason = LACK_OF_PROGRESS;
+    printf("worker %d finished after %d epochs, %s\n",
+           rank, trainer.getEpoch(), reasonName[reason].c_str());
     }
-*/
 
-  oldmse = mse;
+  delete ring;
+
+  exit(0);
   }
 
+int epoch = trainer.getEpoch()+1;
+
+double mse = trainer.getMse();
+
 if( Trace::atLevel(1) ) 
   {
   std::cout << "\nTraining ends at epoch " << epoch << ", "
-            << reasonName[reason] << "." << std::endl;
+            << reasonName[reason] << ", after " << trainingTime << " seconds." << std::endl;
+
+  if( !validationSamples.empty() )
+    {
+    std::cout << "Keeping the weights of epoch " << trainer.getBestEpoch()
+              << ", with validation " << (validateOnUsage ? "usage error " : "mse ")
+              << trainer.getBestValidation() << "." << std::endl;
+    }
   }
 
 std::cout << "\nFinal Weights:" << std::endl;
 
 network.showWeights("final");
 
-// Write final trained network weights and info to file for later use.
-network.saveStats(weightStream);
-network.saveWeights(weightStream);
+// Write final trained network weights and info to file for later use,
+// replacing it only once they are all written.
+if( !publishWeights(weightFile, network) )
+  {
+  printf("Could not create weight file: %s\n", weightFile);
+  }
 
 // Show performance on all samples
 
 std::cout << "\nFinal performance on all test samples:" << std::endl;
 
-signAgreement = 0;
-
 // Run on test samples
 double usageError = runSamples(mse, testSamples, network, outputStream);
 
 std::cout << "\nAfter " << epoch-1 << " epochs using "
           << modeName[mode];
 
-if( mode != RPROP )
+if( mode != RPROP && mode != LBFGS && mode != LM )
   {
   std::cout << " with learning rate " << rate;
+
+  if( schedule != CONSTANT_RATE )
+    {
+    std::cout << " ending at " << trainer.getRate();
+    }
+  }
+else if( mode == RPROP )
+  {
+  std::cout << " (" << rprop.getVariantName() << ")";
+  }
+
+if( optimizer )
+  {
+  std::cout << " (" << optimizerName << ")";
   }
 
 std::cout << ", " << reasonName[reason]
-          << ", test mse = " << mse/nsamples
-          << ", total usage error = " << usageError << "/" << nsamples
-          << " (" << 100*usageError/nsamples << "%)"
+          << " after " << trainingTime << " seconds ("
+          << (trainingTime > 0 ? gradients/trainingTime : 0)
+          << " sample gradients per second)"
+          << ", test mse = " << mse/nTestSamples
+          << ", total usage error = " << usageError << "/" << nTestSamples
+          << " (" << 100*usageError/nTestSamples << "%)"
           << std::endl;
 }
 
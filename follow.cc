@@ -0,0 +1,399 @@
+// file:    follow.cc
+// purpose: keeps a trained network up to date with samples appended to a file
+
+/**
+ * Loads a network saved by bp, then follows a sample file that another
+ * program appends to (in the format bp reads), training on the new samples
+ * as they arrive and publishing the weights from time to time.
+ *
+ * Each update takes a few epochs over at most --max-new of the waiting
+ * samples together with a replay buffer: a random subset of up to --replay
+ * of the samples seen before, so that the network does not forget them.
+ * Its cost is bounded by --steps times the sum of the two.  The samples
+ * already in the file when it starts only fill the replay buffer.
+ *
+ * The weights are saved in the format bp and test use, replacing the
+ * published file atomically, at most every --publish-every seconds and
+ * on exit (on an interrupt or terminate signal, or after --idle-exit
+ * seconds with no new samples).
+ *
+ * ./follow <weight file> <sample file> <published weight file> [options]
+ * e.x. ./follow licks.weights.save ratings.in licks.weights.live --publish-every 10
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "helper.h"
+#include "SampleFeed.h"
+#include "Trainer.h"
+
+const MODE    defaultMode                = ONLINE;
+
+const double  defaultLearningRate        = 0.005;
+
+const int     defaultSteps               = 5;
+
+const int     defaultReplaySize          = 500;
+
+const int     defaultMaxNew              = 100;
+
+const double  defaultPublishInterval     = 60;	// seconds
+
+const double  defaultPollInterval        = 1;	// seconds
+
+const int     defaultTrace               = 1;
+
+const int     minimumParameters          = 3;
+
+/**
+ * set by an interrupt or terminate signal, to stop after the current update
+ */
+
+volatile sig_atomic_t stopping = 0;
+
+void stop(int signal)
+  {
+  stopping = 1;
+  }
+
+/**
+ * Offer a sample to the replay buffer, which keeps a uniform random subset
+ * of up to capacity of all the samples offered (reservoir sampling).
+ * A sample not kept, or pushed out, is deleted.
+ */
+
+void remember(std::vector<Sample*>& replay, int capacity, Sample* sample,
+              long& offered, Random& random)
+  {
+  offered++;
+
+  if( (int)replay.size() < capacity )
+    {
+    replay.push_back(sample);
+    return;
+    }
+
+  long k = (long)(random.uniform()*offered);
+
+  if( k < capacity )
+    {
+    delete replay[k];
+    replay[k] = sample;
+    }
+  else
+    {
+    delete sample;
+    }
+  }
+
+/**
+ * main program loads the network and follows the sample file.
+ */
+
+int main(int argc, char** argv)
+{
+if( argc <= minimumParameters )
+  {
+  std::cout << "parameters: <weight file> <sample file> <published weight file> [options]"
+            << std::endl;
+  std::cout << "options:" << std::endl
+            << "    --mode <mode>    training mode, as for bp (default " << defaultMode
+            << ", " << modeName[defaultMode] << ")" << std::endl
+            << "    --rate <rate>    learning rate (default " << defaultLearningRate << ")"
+            << std::endl
+            << "    --delta-init <step>    rprop initial step size (default 0.1)" << std::endl
+            << "    --steps <epochs>    epochs per update (default " << defaultSteps << ")"
+            << std::endl
+            << "    --replay <samples>    old samples kept for replay (default "
+            << defaultReplaySize << ")" << std::endl
+            << "    --max-new <samples>    new samples per update (default "
+            << defaultMaxNew << ")" << std::endl
+            << "    --publish-every <seconds>    least time between publications (default "
+            << defaultPublishInterval << ")" << std::endl
+            << "    --poll <seconds>    time between looks at the sample file (default "
+            << defaultPollInterval << ")" << std::endl
+            << "    --idle-exit <seconds>    exit after this long with no new samples"
+            << std::endl
+            << "    --trace <level>    trace level (default " << defaultTrace << ")" << std::endl;
+  exit(0);
+  }
+
+const char* weightFile = argv[1];
+const char* sampleFile = argv[2];
+const char* publishFile = argv[3];
+
+MODE mode = defaultMode;
+double rate = defaultLearningRate;
+Rprop rprop;
+int steps = defaultSteps;
+int replaySize = defaultReplaySize;
+int maxNew = defaultMaxNew;
+double publishInterval = defaultPublishInterval;
+double pollInterval = defaultPollInterval;
+double idleExit = 0;		// seconds, 0 for never
+
+Trace::setLevel(defaultTrace);
+
+for( int i = minimumParameters+1; i < argc; i++ )
+  {
+  std::string option = argv[i];
+
+  if( option == "--mode" )
+    {
+    int m = getInteger(getOptionValue(argc, argv, i));
+
+    if( m < ONLINE || m > LM )
+      {
+      printf("mode must be from %d to %d\n", ONLINE, LM);
+      exit(1);
+      }
+
+    mode = (MODE)m;
+    }
+  else if( option == "--rate" )
+    {
+    rate = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--delta-init" )
+    {
+    rprop.setDeltaInit(getFloat(getOptionValue(argc, argv, i)));
+    }
+  else if( option == "--steps" )
+    {
+    steps = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--replay" )
+    {
+    replaySize = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--max-new" )
+    {
+    maxNew = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--publish-every" )
+    {
+    publishInterval = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--poll" )
+    {
+    pollInterval = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--idle-exit" )
+    {
+    idleExit = getFloat(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--trace" )
+    {
+    Trace::setLevel(getInteger(getOptionValue(argc, argv, i)));
+    }
+  else
+    {
+    printf("error in command: unknown option %s\n", argv[i]);
+    exit(1);
+    }
+  }
+
+if( steps < 1 || replaySize < 0 || maxNew < 1
+ || publishInterval < 0 || !(pollInterval > 0) || idleExit < 0 )
+  {
+  printf("error in command: steps and new samples must be positive, "
+         "and the other options not negative\n");
+  exit(1);
+  }
+
+// Load the network as test does.
+
+std::ifstream weightStream(weightFile);
+
+int inputDimension;
+int numberLayers;
+int* layerSize;
+ActivationFunction** layerType;
+
+if( !weightStream || !loadStats(weightStream, inputDimension, numberLayers, layerSize, layerType) )
+  {
+  printf("Weight file %s is missing or has no network attributes\n", weightFile);
+  exit(1);
+  }
+
+Network network(numberLayers, layerSize, layerType, inputDimension);
+
+if( !loadWeights(weightStream, network) )
+  {
+  printf("Weight file %s has missing or misplaced weights\n", weightFile);
+  exit(1);
+  }
+
+bool onehotOutput = isCategorical(layerType[numberLayers-1]);
+
+int outputDimension = onehotOutput ? 1 : layerSize[numberLayers-1];
+
+if( Trace::atLevel(1) )
+  {
+  printf("Loaded %s: %d inputs, %d layers, %d weights.\n",
+         weightFile, inputDimension, numberLayers, network.getParameterCount());
+
+  printf("Following %s, %s mode, %d epochs per update, replaying up to %d samples.\n",
+         sampleFile, modeName[mode].c_str(), steps, replaySize);
+  }
+
+signal(SIGINT, stop);
+signal(SIGTERM, stop);
+
+SampleFeed feed(sampleFile);
+
+std::vector<Sample*> replay;	// the replay buffer
+long offered = 0;		// samples ever offered to it
+Random replayRandom;		// for choosing the samples kept
+
+std::list<Sample*> waiting;	// new samples not yet trained on
+
+bool first = true;
+bool changed = false;		// weights not yet published
+int updates = 0;
+long trained = 0;
+
+double lastPublish = getTime();
+double lastArrival = lastPublish;
+
+while( !stopping )
+  {
+  std::list<Sample*> arrived;
+
+  int count = feed.poll(arrived);
+
+  if( feed.hasDimensions()
+   && (feed.getInputDimension() != inputDimension || feed.getOutputDimension() != outputDimension) )
+    {
+    printf("error, %s has dimensions %d and %d, but the network needs %d and %d\n",
+           sampleFile, feed.getOutputDimension(), feed.getInputDimension(),
+           outputDimension, inputDimension);
+    exit(1);
+    }
+
+  if( first )
+    {
+    // The samples already there only fill the replay buffer.
+
+    for( std::list<Sample*>::iterator sample = arrived.begin(); sample != arrived.end(); sample++ )
+      {
+      remember(replay, replaySize, *sample, offered, replayRandom);
+      }
+
+    if( Trace::atLevel(1) )
+      {
+      printf("%d samples already in %s, %d kept for replay.\n",
+             count, sampleFile, (int)replay.size());
+      }
+
+    arrived.clear();
+    count = 0;
+    first = false;
+    }
+
+  double now = getTime();
+
+  if( count > 0 )
+    {
+    waiting.splice(waiting.end(), arrived);
+    lastArrival = now;
+    }
+
+  if( !waiting.empty() )
+    {
+    // One update, on up to maxNew waiting samples and the replay buffer.
+
+    std::list<Sample*> fresh;
+
+    while( !waiting.empty() && (int)fresh.size() < maxNew )
+      {
+      fresh.push_back(waiting.front());
+      waiting.pop_front();
+      }
+
+    std::list<Sample*> samples(fresh.begin(), fresh.end());
+
+    samples.insert(samples.end(), replay.begin(), replay.end());
+
+    Trainer trainer(network, samples, mode, rate, 0, steps);
+
+    trainer.setRprop(rprop);
+
+    trainer.train();
+
+    updates++;
+    trained += fresh.size();
+    changed = true;
+
+    if( Trace::atLevel(1) )
+      {
+      printf("update %d: %d new and %d replayed samples, mse %10.8f, %d waiting\n",
+             updates, (int)fresh.size(), (int)replay.size(), trainer.getMse(),
+             (int)waiting.size());
+      fflush(stdout);
+      }
+
+    for( std::list<Sample*>::iterator sample = fresh.begin(); sample != fresh.end(); sample++ )
+      {
+      remember(replay, replaySize, *sample, offered, replayRandom);
+      }
+    }
+  else if( idleExit > 0 && now - lastArrival >= idleExit )
+    {
+    break;
+    }
+  else
+    {
+    usleep((useconds_t)(pollInterval*1e6));
+    }
+
+  now = getTime();
+
+  if( changed && now - lastPublish >= publishInterval )
+    {
+    if( publishWeights(publishFile, network) )
+      {
+      changed = false;
+
+      if( Trace::atLevel(1) )
+        {
+        printf("published %s after %d updates\n", publishFile, updates);
+        fflush(stdout);
+        }
+      }
+    else
+      {
+      printf("warning, cannot publish %s\n", publishFile);
+      }
+
+    lastPublish = now;
+    }
+  }
+
+if( changed && !publishWeights(publishFile, network) )
+  {
+  printf("warning, cannot publish %s\n", publishFile);
+  }
+
+if( Trace::atLevel(1) )
+  {
+  printf("Stopped after %d updates on %ld new samples.\n", updates, trained);
+  }
+
+for( std::list<Sample*>::iterator sample = waiting.begin(); sample != waiting.end(); sample++ )
+  {
+  delete *sample;
+  }
+
+for( std::vector<Sample*>::iterator sample = replay.begin(); sample != replay.end(); sample++ )
+  {
+  delete *sample;
+  }
+
+return 0;
+}
@@ -4,6 +4,11 @@
 
 #include "helper.h"
 
+#include <stdio.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
 ActivationFunction* hardlim  = new Hardlim();
 ActivationFunction* hardlims = new Hardlims();
 ActivationFunction* onehot   = new Onehot();
@@ -11,6 +16,7 @@ ActivationFunction* logsig   = new Logsig();
 ActivationFunction* purelin  = new Purelin();
 ActivationFunction* satlin   = new Satlin();
 ActivationFunction* satlins  = new Satlins();
+ActivationFunction* softmax  = new Softmax();
 ActivationFunction* tansig   = new Tansig();
 
 /**
@@ -19,6 +25,8 @@ ActivationFunction* tansig   = new Tansig();
 
 ActivationFunction* getLayerType(std::string name)
   {
+  if( name.compare(0, 5, "conv:") == 0 ) return getConvolution(name);
+
   if( name == "hardlim" )  return hardlim;
   if( name == "hardlims" ) return hardlims;
   if( name == "logsig" )   return logsig;
@@ -26,17 +34,183 @@ ActivationFunction* getLayerType(std::string name)
   if( name == "purelin" )  return purelin;
   if( name == "satlin" )   return satlin;
   if( name == "satlins" )  return satlins;
+  if( name == "softmax" )  return softmax;
   if( name == "tansig" )   return tansig;
 
   std::cout << "error, unrecognized function: " << name << std::endl;
   exit(1);  
   }
 
+/**
+ * Get a Convolution from its name, conv:<function>:<width>:<kernel>, followed
+ * optionally by :<stride>, :<pool> and :<lead> (1, 1 and 0 by default).
+ */
+
+ActivationFunction* getConvolution(std::string name)
+  {
+  std::vector<std::string> field = split(name, ':');
+
+  if( field.size() < 4 || field.size() > 7 )
+    {
+    std::cout << "error, a convolution is conv:<function>:<width>:<kernel>"
+                 "[:<stride>[:<pool>[:<lead>]]], not " << name << std::endl;
+    exit(1);
+    }
+
+  ActivationFunction* function = getLayerType(field[1]);
+
+  if( isCategorical(function) || isConvolution(function) )
+    {
+    std::cout << "error, a convolution cannot have the function " << field[1] << std::endl;
+    exit(1);
+    }
+
+  int width  = getInteger(field[2].c_str());
+  int kernel = getInteger(field[3].c_str());
+  int stride = field.size() > 4 ? getInteger(field[4].c_str()) : 1;
+  int pool   = field.size() > 5 ? getInteger(field[5].c_str()) : 1;
+  int lead   = field.size() > 6 ? getInteger(field[6].c_str()) : 0;
+
+  if( width < 1 || kernel < 1 || stride < 1 || pool < 1 || lead < 0 )
+    {
+    std::cout << "error, the width, kernel, stride and pool of a convolution must be "
+                 "positive, and its lead not negative: " << name << std::endl;
+    exit(1);
+    }
+
+  return new Convolution(function, width, kernel, stride, pool, lead);
+  }
+
+/**
+ * Check that only the first layer is a Convolution, and that it fits the
+ * inputs, exiting with a message if not.
+ */
+
+void checkConvolution(int numberLayers, ActivationFunction** layerType, int inputDimension)
+  {
+  for( int i = 1; i < numberLayers; i++ )
+    {
+    if( isConvolution(layerType[i]) )
+      {
+      std::cout << "error, only the first layer can be a convolution, not layer " << i
+                << std::endl;
+      exit(1);
+      }
+    }
+
+  if( !isConvolution(layerType[0]) )
+    {
+    return;
+    }
+
+  Convolution* convolution = (Convolution*)layerType[0];
+
+  if( !convolution->fits(inputDimension) )
+    {
+    std::cout << "error, " << convolution->getName() << " needs the " << inputDimension
+              << " inputs to be " << convolution->getLead() << " lead inputs and at least "
+              << convolution->getKernel() << " whole slots of " << convolution->getWidth()
+              << std::endl;
+    exit(1);
+    }
+  }
+
+/**
+ * Return whether a layer type is an output layer for categories.
+ */
+
+bool isCategorical(ActivationFunction* type)
+  {
+  return type->getName() == "onehot" || type->getName() == "softmax";
+  }
+
+/**
+ * Get a weight initialization scheme by matching name to string.
+ */
+
+INIT getInitScheme(std::string name)
+  {
+  for( int i = UNIFORM_INIT; i <= HE; i++ )
+    {
+    if( name == initName[i] ) return (INIT)i;
+    }
+
+  std::cout << "error, unrecognized initialization: " << name << std::endl;
+  exit(1);
+  }
+
+/**
+ * Split a list at each separator.
+ */
+
+std::vector<std::string> split(const std::string& list, char separator)
+  {
+  std::vector<std::string> items;
+
+  size_t start = 0;
+
+  for( ;; )
+    {
+    size_t end = list.find(separator, start);
+
+    items.push_back(list.substr(start, end == std::string::npos ? std::string::npos : end - start));
+
+    if( end == std::string::npos )
+      {
+      return items;
+      }
+
+    start = end + 1;
+    }
+  }
+
+/**
+ * Get a number from a command-line argument, exiting if it is not one.
+ */
+
+double getFloat(const char* str)
+  {
+  char* endptr;
+  double result = strtod(str, &endptr);
+  if( *endptr != '\0' )
+    {
+    printf("error in command: expected floating point, but found %s\n", str);
+    exit(1);
+    }
+  return result;
+  }
+
+int getInteger(const char* str)
+  {
+  char* endptr;
+  int result = strtol(str, &endptr, 0);
+  if( *endptr != '\0' )
+    {
+    printf("error in command: expected integer, but found %s\n", str);
+    exit(1);
+    }
+  return result;
+  }
+
+/**
+ * Get the value following the option at argv[i], advancing i past it.
+ */
+
+const char* getOptionValue(int argc, char** argv, int& i)
+  {
+  if( i+1 >= argc )
+    {
+    printf("error in command: option %s needs a value\n", argv[i]);
+    exit(1);
+    }
+  return argv[++i];
+  }
+
 /**
  * Get samples from standard input.
  */
 
-void getSamples(char* inputFile, int& outputDimension, int& inputDimension, std::list<Sample*>& listOfSamples)
+void getSamples(const char* inputFile, int& outputDimension, int& inputDimension, std::list<Sample*>& listOfSamples)
   {
   std::ifstream in(inputFile);
 
@@ -118,6 +292,284 @@ void getSamples(char* inputFile, int& outputDimension, int& inputDimension, std:
   }
 }
 
+/**
+ * Move a random fraction of the samples from one list to another,
+ * keeping their order in both.
+ *
+ * Each remaining sample is chosen with probability (still needed)/(still
+ * left), which takes exactly the rounded fraction of them.
+ */
+
+void splitSamples(std::list<Sample*>& samples, double fraction, std::list<Sample*>& heldOut,
+                  Random& random)
+  {
+  int left = samples.size();
+  int needed = (int)(fraction*left + 0.5);
+
+  std::list<Sample*>::iterator sample = samples.begin();
+
+  while( sample != samples.end() )
+    {
+    if( random.uniform()*left < needed )
+      {
+      heldOut.push_back(*sample);
+      sample = samples.erase(sample);
+      needed--;
+      }
+    else
+      {
+      sample++;
+      }
+
+    left--;
+    }
+  }
+
+/**
+ * Read the network attributes saved by Network::saveStats: the input
+ * dimension, the number of layers, and the size and type of each layer,
+ * allocating the arrays.  Returns false if they cannot be read.
+ */
+
+bool loadStats(std::ifstream& weightStream, int& inputDimension, int& numberLayers,
+               int*& layerSize, ActivationFunction**& layerType)
+  {
+  if( !(weightStream >> inputDimension >> numberLayers) || numberLayers < 1 )
+    {
+    return false;
+    }
+
+  layerSize = new int[numberLayers];
+  layerType = new ActivationFunction*[numberLayers];
+
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    std::string type;
+
+    if( !(weightStream >> layerSize[i] >> type) )
+      {
+      return false;
+      }
+
+    layerType[i] = getLayerType(type);
+    }
+
+  return true;
+  }
+
+/**
+ * Read the weights saved by Network::saveWeights into a Network of the same
+ * shape.  Returns false if any neuron is missing or does not fit.
+ *
+ * Each neuron is saved as its layer and neuron index, its number of inputs,
+ * the weights with the bias last, and its sensitivity.
+ */
+
+bool loadWeights(std::ifstream& weightStream, Network& network)
+  {
+  int numberLayers = network.getNumberLayers();
+
+  int needed = 0;
+
+  for( int i = 0; i < numberLayers; i++ )
+    {
+    needed += network.getLayer(i).getNumberOfNeurons();
+    }
+
+  std::vector<bool> seen(needed, false);
+
+  int layer, neuron, numberOfInputs;
+
+  while( weightStream >> layer )
+    {
+    if( !(weightStream >> neuron >> numberOfInputs)
+     || layer < 0 || layer >= numberLayers
+     || neuron < 0 || neuron >= network.getLayer(layer).getNumberOfNeurons()
+     || numberOfInputs != network.getLayer(layer).getNumberOfInputs() )
+      {
+      return false;
+      }
+
+    for( int j = 0; j <= numberOfInputs; j++ )
+      {
+      double weight;
+
+      if( !(weightStream >> weight) )
+        {
+        return false;
+        }
+
+      network.setWeight(layer, neuron, j, weight);
+      }
+
+    double sensitivity;
+
+    if( !(weightStream >> sensitivity) )
+      {
+      return false;
+      }
+
+    network.setFixedSensitivity(layer, neuron, sensitivity);
+
+    int k = neuron;
+
+    for( int i = 0; i < layer; i++ )
+      {
+      k += network.getLayer(i).getNumberOfNeurons();
+      }
+
+    if( !seen[k] )
+      {
+      seen[k] = true;
+      needed--;
+      }
+    }
+
+  return needed == 0;
+  }
+
+/**
+ * Set the weights of a Network from a file saved by bp (the stats followed
+ * by the weights), after checking that the file has the Network's layers.
+ * Returns false, with a message, if it cannot be used.
+ */
+
+bool loadWeightFile(const char* weightFile, Network& network)
+  {
+  std::ifstream weightStream(weightFile);
+
+  if( !weightStream )
+    {
+    std::cout << "Could not find weight file: " << weightFile << std::endl;
+    return false;
+    }
+
+  int inputDimension;
+  int numberLayers;
+  int* layerSize = NULL;
+  ActivationFunction** layerType = NULL;
+
+  bool ok = loadStats(weightStream, inputDimension, numberLayers, layerSize, layerType);
+
+  if( !ok )
+    {
+    std::cout << "Weight file " << weightFile << " has no network attributes." << std::endl;
+    }
+  else if( inputDimension != network.getInputDimension()
+        || numberLayers != network.getNumberLayers() )
+    {
+    std::cout << "Weight file " << weightFile << " has " << numberLayers
+              << " layers and " << inputDimension << " inputs, not "
+              << network.getNumberLayers() << " and " << network.getInputDimension()
+              << "." << std::endl;
+    ok = false;
+    }
+  else
+    {
+    for( int i = 0; ok && i < numberLayers; i++ )
+      {
+      const Layer& layer = network.getLayer(i);
+
+      if( layerSize[i] != layer.getNumberOfNeurons() || layerType[i]->getName() != layer.getType() )
+        {
+        std::cout << "Weight file " << weightFile << " has layer " << i << " as "
+                  << layerType[i]->getName() << " " << layerSize[i] << ", not "
+                  << layer.getType() << " " << layer.getNumberOfNeurons() << "." << std::endl;
+        ok = false;
+        }
+      }
+    }
+
+  if( ok && !loadWeights(weightStream, network) )
+    {
+    std::cout << "Weight file " << weightFile << " has missing or misplaced weights." << std::endl;
+    ok = false;
+    }
+
+  delete [] layerSize;
+  delete [] layerType;
+
+  return ok;
+  }
+
+/**
+ * Save the stats and weights of a Network, as bp does, to a file that is
+ * replaced atomically: they are written to <file>.tmp, flushed to the disk,
+ * and renamed.  Returns false if they cannot be written.
+ */
+
+bool publishWeights(const char* weightFile, Network& network)
+  {
+  std::string temporary = std::string(weightFile) + ".tmp";
+
+  std::ofstream weightStream(temporary.c_str());
+
+  network.saveStats(weightStream);
+  network.saveWeights(weightStream);
+
+  weightStream.close();
+
+  bool ok = !weightStream.fail();
+
+  // An ofstream cannot be synced, so the file is opened again for that.
+
+  FILE* file = fopen(temporary.c_str(), "r");
+
+  ok = ok && file != NULL && fsync(fileno(file)) == 0;
+
+  if( file )
+    {
+    fclose(file);
+    }
+
+  if( !ok || rename(temporary.c_str(), weightFile) != 0 )
+    {
+    remove(temporary.c_str());
+    return false;
+    }
+
+  return true;
+  }
+
+/**
+ * Get the wall clock time in seconds.
+ */
+
+double getTime()
+  {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec*1e-6;
+  }
+
+/**
+ * Evaluate a network on samples without showing or saving anything,
+ * returning the mse when fired and setting the number of usage errors.
+ */
+
+double evaluateSamples(const std::list<Sample*>& samples, Network& network, int& usageErrors)
+  {
+  double sse = 0;
+
+  usageErrors = 0;
+
+  for( std::list<Sample*>::const_iterator sample = samples.begin();
+       sample != samples.end();
+       sample++
+     )
+    {
+    network.use(**sample);
+
+    usageErrors += network.computeUsageError(**sample);
+
+    network.fire(**sample);
+
+    sse += network.computeError(**sample);
+    }
+
+  return samples.empty() ? 0 : sse/samples.size();
+  }
+
 /**
  * Run samples through net and save output values.
  */
@@ -5,8 +5,11 @@
 #include <list>
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include "ActivationFunction.h"
+#include "Convolution.h"
 #include "Hardlim.h"
 #include "Hardlims.h"
 #include "Logsig.h"
@@ -16,6 +19,7 @@
 #include "Sample.h"
 #include "Satlin.h"
 #include "Satlins.h"
+#include "Softmax.h"
 #include "Tansig.h"
 #include "Trace.h"
 
@@ -25,11 +29,112 @@
 
 ActivationFunction* getLayerType(std::string name);
 
+/**
+ * Get a Convolution from its name, conv:<function>:<width>:<kernel>, followed
+ * optionally by :<stride>, :<pool> and :<lead> (1, 1 and 0 by default).
+ * Each call makes a new one.
+ */
+
+ActivationFunction* getConvolution(std::string name);
+
+/**
+ * Check that only the first layer is a Convolution, and that it fits the
+ * inputs, exiting with a message if not.
+ */
+
+void checkConvolution(int numberLayers, ActivationFunction** layerType, int inputDimension);
+
+/**
+ * Return whether a layer type is an output layer for categories (onehot or
+ * softmax), whose samples have one output, the index of the category.
+ */
+
+bool isCategorical(ActivationFunction* type);
+
+/**
+ * Get a weight initialization scheme by matching name to string.
+ */
+
+INIT getInitScheme(std::string name);
+
+/**
+ * Split a list at each separator.
+ */
+
+std::vector<std::string> split(const std::string& list, char separator);
+
+/**
+ * Get a number from a command-line argument, exiting if it is not one.
+ */
+
+double getFloat(const char* str);
+
+int getInteger(const char* str);
+
+/**
+ * Get the value following the option at argv[i], advancing i past it.
+ */
+
+const char* getOptionValue(int argc, char** argv, int& i);
+
 /**
  * Get samples from standard input.
  */
 
-void getSamples(char* inputFile, int& outputDimension, int& inputDimension, std::list<Sample*>& listOfSamples);
+void getSamples(const char* inputFile, int& outputDimension, int& inputDimension, std::list<Sample*>& listOfSamples);
+
+/**
+ * Move a random fraction of the samples from one list to another,
+ * keeping their order in both.
+ */
+
+void splitSamples(std::list<Sample*>& samples, double fraction, std::list<Sample*>& heldOut,
+                  Random& random);
+
+/**
+ * Read the network attributes saved by Network::saveStats: the input
+ * dimension, the number of layers, and the size and type of each layer,
+ * allocating the arrays.  Returns false if they cannot be read.
+ */
+
+bool loadStats(std::ifstream& weightStream, int& inputDimension, int& numberLayers,
+               int*& layerSize, ActivationFunction**& layerType);
+
+/**
+ * Read the weights saved by Network::saveWeights into a Network of the same
+ * shape.  Returns false if any neuron is missing or does not fit.
+ */
+
+bool loadWeights(std::ifstream& weightStream, Network& network);
+
+/**
+ * Set the weights of a Network from a file saved by bp (the stats followed
+ * by the weights), after checking that the file has the Network's layers.
+ * Returns false, with a message, if it cannot be used.
+ */
+
+bool loadWeightFile(const char* weightFile, Network& network);
+
+/**
+ * Save the stats and weights of a Network, as bp does, to a file that is
+ * replaced atomically: they are written to <file>.tmp, flushed to the disk,
+ * and renamed.  Returns false if they cannot be written.
+ */
+
+bool publishWeights(const char* weightFile, Network& network);
+
+/**
+ * Get the wall clock time in seconds.
+ */
+
+double getTime();
+
+/**
+ * Evaluate a network on samples without showing or saving anything,
+ * returning the mse when fired and setting the number of usage errors.
+ */
+
+double evaluateSamples(const std::list<Sample*>& samples, Network& network, int& usageErrors);
 
 /**
  * Run samples through net and save output values.
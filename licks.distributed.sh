@@ -0,0 +1,24 @@
+#
+# Trains on licks.in with several local worker processes, each with a share
+# of the samples, summing their gradients over Unix-domain sockets.  Worker 0
+# saves the weights and outputs and reports the result.
+#
+# ./licks.distributed.sh [workers]    (4 by default)
+
+workers=${1:-4}
+ring=/tmp/licks.ring.$$
+
+for rank in `seq 1 $((workers-1))`
+do
+  ./bp licks.in 300 .005 .0001 2 0 /tmp/licks.worker.weights 2 logsig 16 purelin 1 \
+       licks.test.in /tmp/licks.worker.outputs --full-batch \
+       --distributed $ring --workers $workers --rank $rank > /dev/null &
+done
+
+./bp licks.in 300 .005 .0001 2 1 licks.weights.save 2 logsig 16 purelin 1 \
+     licks.test.in outputs.save --full-batch \
+     --distributed $ring --workers $workers --rank 0
+
+wait
+
+rm -f /tmp/licks.worker.weights /tmp/licks.worker.outputs
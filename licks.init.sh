@@ -0,0 +1,24 @@
+#
+# Compares the weight initialization schemes on licks.in: the epochs and the
+# training time each takes to reach the mse goal, averaged over several seeds.
+#
+# ./licks.init.sh [mode [seeds]]    (rprop and 5 seeds by default)
+
+mode=${1:-2}
+seeds=${2:-5}
+
+printf "%-14s %8s %10s %10s\n" scheme reached epochs seconds
+
+for init in uniform nguyen-widrow xavier he
+do
+  for seed in `seq 1 $seeds`
+  do
+    ./bp licks.in 5000 .005 .0001 $mode 0 /tmp/licks.init.weights 2 logsig 16 purelin 1 \
+         licks.test.in /tmp/licks.init.outputs --init $init --seed $seed | grep "^After"
+  done | awk -v init=$init '
+    { epochs += $2; reached += /goal reached/;
+      for( i = 1; i < NF; i++ ) if( $i == "after" && $(i+2) == "seconds" ) seconds += $(i+1) }
+    END { printf "%-14s %6d/%d %10.1f %10.2f\n", init, reached, NR, epochs/NR, seconds/NR }'
+done
+
+rm -f /tmp/licks.init.weights /tmp/licks.init.outputs
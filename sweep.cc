@@ -0,0 +1,458 @@
+// file:    sweep.cc
+// purpose: trains many network configurations at once on one copy of the samples
+
+/**
+ * Reads the training and test samples once, then trains a network for
+ * every combination of the hidden layers, activation functions, learning
+ * rates and modes given (or a random selection of them) on a pool of
+ * threads, which share the samples read-only.  The results are ranked by
+ * test mse, then usage errors, and the weights of the best network are
+ * saved in the format test reads.
+ *
+ * ./sweep <training file> <test file> <max epochs> <mse goal> <best weight file> [options]
+ * e.x. ./sweep licks.in licks.test.in 300 .0001 best.save --hidden 8,16,16x8 --mode 2,4
+ *
+ * Each network takes its random numbers from its own stream of the seed,
+ * so a sweep gives the same results with any number of threads.  The
+ * largest configurations are started first, so that the threads stay busy
+ * to the end.
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "helper.h"
+#include "Task.h"
+#include "ThreadPool.h"
+#include "Trainer.h"
+
+const int     defaultTrace               = 1;
+
+const int     minimumParameters          = 5;
+
+/**
+ * One configuration of the sweep, which trains its network when run
+ * and keeps the results.
+ */
+
+class SweepRun : public Task
+{
+public:
+
+std::string description;
+
+/**
+ * the configuration
+ */
+
+std::vector<int> layerSize;
+
+std::vector<ActivationFunction*> layerType;
+
+MODE mode;
+
+double rate;
+
+Network* network;
+
+Trainer* trainer;
+
+const std::list<Sample*>* testSamples;
+
+/**
+ * an estimate of the work, for starting the largest runs first
+ */
+
+double cost;
+
+int epochs;
+
+double trainingMse;
+
+double testMse;
+
+int usageErrors;
+
+double seconds;
+
+TERMINATION_REASON reason;
+
+void run()
+  {
+  double start = getTime();
+
+  reason = trainer->train();
+
+  seconds = getTime() - start;
+
+  epochs = trainer->getEpoch();
+  trainingMse = trainer->getMse();
+
+  delete trainer;	// its work space is no longer needed
+  trainer = NULL;
+
+  testMse = evaluateSamples(*testSamples, *network, usageErrors);
+
+  if( Trace::atLevel(1) )
+    {
+    printf("finished %s: test mse %10.8f, usage errors %d, %d epochs, %.2f seconds\n",
+           description.c_str(), testMse, usageErrors, epochs, seconds);
+    fflush(stdout);
+    }
+  }
+
+~SweepRun()
+  {
+  delete trainer;
+  delete network;
+  }
+};
+
+
+bool runIsLarger(const SweepRun* a, const SweepRun* b)
+  {
+  return a->cost > b->cost;
+  }
+
+/**
+ * Rank by test mse, then usage errors.  A run that diverged, with no finite
+ * test mse, ranks below every one that did not.
+ */
+
+bool runIsBetter(const SweepRun* a, const SweepRun* b)
+  {
+  bool aFinite = isfinite(a->testMse);
+  bool bFinite = isfinite(b->testMse);
+
+  if( aFinite != bFinite )
+    {
+    return aFinite;
+    }
+
+  if( aFinite && a->testMse != b->testMse )
+    {
+    return a->testMse < b->testMse;
+    }
+  return a->usageErrors < b->usageErrors;
+  }
+
+
+/**
+ * main program reads the samples and runs the sweep.
+ */
+
+int main(int argc, char** argv)
+{
+Trace::setLevel(defaultTrace);
+
+if( argc <= minimumParameters )
+  {
+  std::cout << "parameters: <training file> <test file> <max epochs> <mse goal> "
+               "<best weight file> [options]" << std::endl;
+  std::cout << "options, each a comma-separated list of values to try:" << std::endl
+            << "    --hidden <sizes>    hidden layer sizes, with x between the sizes of "
+               "several layers, e.g. 8,16,16x8 (default 16)" << std::endl
+            << "    --hidden-type <types>    hidden layer functions (default logsig)" << std::endl
+            << "    --output-type <types>    output layer functions (default purelin)" << std::endl
+            << "    --rate <rates>    learning rates (default .005)" << std::endl
+            << "    --mode <modes>    training modes, as for bp (default 2)" << std::endl
+            << "other options:" << std::endl
+            << "    --categories <n>    categories of a onehot or softmax output layer"
+            << std::endl
+            << "    --random <n>    try n configurations chosen at random" << std::endl
+            << "    --seed <n>    seed of the random choices and weights (default "
+            << defaultSeed << ")" << std::endl
+            << "    --threads <n>    threads (default " << ThreadPool::getProcessorCount()
+            << ", the number of processors)" << std::endl
+            << "    --trace <level>    trace level (default " << defaultTrace << ")" << std::endl;
+  exit(0);
+  }
+
+const char* trainingFile = argv[1];
+const char* testFile = argv[2];
+int epochLimit = getInteger(argv[3]);
+double goal = getFloat(argv[4]);
+const char* bestWeightFile = argv[5];
+
+std::vector<std::string> hiddenList = split("16", ',');
+std::vector<std::string> hiddenTypeList = split("logsig", ',');
+std::vector<std::string> outputTypeList = split("purelin", ',');
+std::vector<std::string> rateList = split(".005", ',');
+std::vector<std::string> modeList = split("2", ',');
+
+int categories = 0;
+int randomCount = 0;
+uint64_t seed = defaultSeed;
+int numberThreads = ThreadPool::getProcessorCount();
+
+for( int i = minimumParameters+1; i < argc; i++ )
+  {
+  std::string option = argv[i];
+
+  if( option == "--hidden" )
+    {
+    hiddenList = split(getOptionValue(argc, argv, i), ',');
+    }
+  else if( option == "--hidden-type" )
+    {
+    hiddenTypeList = split(getOptionValue(argc, argv, i), ',');
+    }
+  else if( option == "--output-type" )
+    {
+    outputTypeList = split(getOptionValue(argc, argv, i), ',');
+    }
+  else if( option == "--rate" )
+    {
+    rateList = split(getOptionValue(argc, argv, i), ',');
+    }
+  else if( option == "--mode" )
+    {
+    modeList = split(getOptionValue(argc, argv, i), ',');
+    }
+  else if( option == "--categories" )
+    {
+    categories = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--random" )
+    {
+    randomCount = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--seed" )
+    {
+    seed = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--threads" )
+    {
+    numberThreads = getInteger(getOptionValue(argc, argv, i));
+    }
+  else if( option == "--trace" )
+    {
+    Trace::setLevel(getInteger(getOptionValue(argc, argv, i)));
+    }
+  else
+    {
+    printf("error in command: unknown option %s\n", argv[i]);
+    exit(1);
+    }
+  }
+
+if( epochLimit < 1 || numberThreads < 1 || randomCount < 0 )
+  {
+  printf("error in command: the epoch limit and threads must be positive\n");
+  exit(1);
+  }
+
+// The samples are read once and shared by every run.
+
+int inputDimension, outputDimension;
+int inputDimension2, outputDimension2;
+
+std::list<Sample*> trainingSamples;
+std::list<Sample*> testSamples;
+
+getSamples(trainingFile, outputDimension, inputDimension, trainingSamples);
+getSamples(testFile, outputDimension2, inputDimension2, testSamples);
+
+if( inputDimension2 != inputDimension || outputDimension2 != outputDimension )
+  {
+  printf("error, the dimensions of the test vs. training file don't match\n");
+  exit(1);
+  }
+
+if( trainingSamples.empty() || testSamples.empty() )
+  {
+  printf("error, neither the training nor the test samples may be empty\n");
+  exit(1);
+  }
+
+// Make the grid of configurations.
+
+std::vector<SweepRun*> runs;
+
+for( size_t h = 0; h < hiddenList.size(); h++ )
+for( size_t ht = 0; ht < hiddenTypeList.size(); ht++ )
+for( size_t ot = 0; ot < outputTypeList.size(); ot++ )
+for( size_t r = 0; r < rateList.size(); r++ )
+for( size_t m = 0; m < modeList.size(); m++ )
+  {
+  std::vector<std::string> sizes = split(hiddenList[h], 'x');
+
+  int numberLayers = sizes.size() + 1;
+
+  std::vector<int> layerSize(numberLayers);
+  std::vector<ActivationFunction*> layerType(numberLayers);
+
+  for( int i = 0; i < numberLayers-1; i++ )
+    {
+    layerSize[i] = getInteger(sizes[i].c_str());
+    layerType[i] = getLayerType(hiddenTypeList[ht]);
+
+    if( layerSize[i] < 1 )
+      {
+      printf("error, hidden layer sizes must be positive\n");
+      exit(1);
+      }
+    }
+
+  layerType[numberLayers-1] = getLayerType(outputTypeList[ot]);
+
+  checkConvolution(numberLayers, &layerType[0], inputDimension);
+
+  bool onehotOutput = isCategorical(layerType[numberLayers-1]);
+
+  if( onehotOutput && (categories < 2 || outputDimension != 1) )
+    {
+    printf("error, a %s output layer needs --categories and one output\n",
+           outputTypeList[ot].c_str());
+    exit(1);
+    }
+
+  layerSize[numberLayers-1] = onehotOutput ? categories : outputDimension;
+
+  int mode = getInteger(modeList[m].c_str());
+
+  if( mode < ONLINE || mode > LM )
+    {
+    printf("error, modes must be from %d to %d\n", ONLINE, LM);
+    exit(1);
+    }
+
+  if( mode == LM && outputTypeList[ot] == "softmax" )
+    {
+    printf("error, levenberg-marquardt needs a squared-error output layer, not softmax\n");
+    exit(1);
+    }
+
+  SweepRun* run = new SweepRun();
+
+  run->description = hiddenList[h] + " " + hiddenTypeList[ht] + " " + outputTypeList[ot]
+                   + ", " + modeName[mode]
+                   + (mode == LBFGS || mode == LM ? "" : " rate " + rateList[r]);
+
+  run->layerSize = layerSize;
+  run->layerType = layerType;
+  run->mode = (MODE)mode;
+  run->rate = getFloat(rateList[r].c_str());
+  run->network = NULL;
+  run->trainer = NULL;
+  run->testSamples = &testSamples;
+
+  runs.push_back(run);
+  }
+
+if( randomCount > 0 && randomCount < (int)runs.size() )
+  {
+  // a random selection: the first randomCount of a partial shuffle
+
+  Random random(seed, 0);
+
+  for( int i = 0; i < randomCount; i++ )
+    {
+    int j = i + (int)(random.uniform()*(runs.size()-i));
+    std::swap(runs[i], runs[j]);
+    }
+
+  for( size_t i = randomCount; i < runs.size(); i++ )
+    {
+    delete runs[i];
+    }
+
+  runs.resize(randomCount);
+  }
+
+// Make the networks and trainers, run k drawing from stream k+1 of the seed.
+
+int nTrainingSamples = trainingSamples.size();
+
+for( size_t k = 0; k < runs.size(); k++ )
+  {
+  SweepRun* run = runs[k];
+
+  run->network = new Network(run->layerSize.size(), &run->layerSize[0], &run->layerType[0],
+                             inputDimension, Random(seed, k+1));
+
+  run->trainer = new Trainer(*run->network, trainingSamples, run->mode, run->rate,
+                             goal, epochLimit);
+
+  double parameters = run->network->getParameterCount();
+  double residuals = (double)nTrainingSamples*run->network->getResidualCount();
+
+  run->cost = parameters*nTrainingSamples;
+
+  if( run->mode == LM )
+    {
+    run->cost *= residuals < parameters ? residuals : parameters;	// order of its system
+    }
+  }
+
+if( Trace::atLevel(1) )
+  {
+  printf("\n%d configurations on %d threads, %d training and %d test samples\n\n",
+         (int)runs.size(), numberThreads, nTrainingSamples, (int)testSamples.size());
+  }
+
+std::vector<SweepRun*> order(runs);
+
+std::stable_sort(order.begin(), order.end(), runIsLarger);
+
+double start = getTime();
+
+  {
+  ThreadPool pool(numberThreads);
+
+  for( size_t k = 0; k < order.size(); k++ )
+    {
+    pool.add(order[k]);
+    }
+
+  pool.wait();
+  }
+
+double seconds = getTime() - start;
+
+// Rank the results.
+
+std::stable_sort(order.begin(), order.end(), runIsBetter);
+
+printf("\n%4s  %-10s  %6s  %-10s  %6s  %8s  %s\n",
+       "rank", "test mse", "usage", "train mse", "epochs", "seconds", "configuration");
+
+for( size_t k = 0; k < order.size(); k++ )
+  {
+  SweepRun* run = order[k];
+
+  printf("%4d  %10.8f  %6d  %10.8f  %6d  %8.2f  %s (%s)\n",
+         (int)k+1, run->testMse, run->usageErrors, run->trainingMse, run->epochs,
+         run->seconds, run->description.c_str(), reasonName[run->reason].c_str());
+  }
+
+printf("\nSweep of %d configurations took %.2f seconds.\n", (int)order.size(), seconds);
+
+if( !isfinite(order[0]->testMse) )
+  {
+  printf("error, every configuration diverged; no weights saved in %s\n", bestWeightFile);
+  exit(1);
+  }
+
+if( publishWeights(bestWeightFile, *order[0]->network) )
+  {
+  printf("Weights of the best configuration, %s, saved in %s.\n",
+         order[0]->description.c_str(), bestWeightFile);
+  }
+else
+  {
+  printf("error, cannot save %s\n", bestWeightFile);
+  exit(1);
+  }
+
+for( size_t k = 0; k < runs.size(); k++ )
+  {
+  delete runs[k];
+  }
+
+return 0;
+}
@@ -23,46 +23,6 @@ int numberLayers;
 int* layerSize;
 ActivationFunction** layerType;
 
-/**
- * Read in neuron weights from file.
- */
-
-void loadNextNeuronWeights(std::ifstream& weightStream, std::vector<double>& weights)
-{
-  int numberOfInputs;
-  weightStream >> numberOfInputs;
-  double weight;
-  weights.clear();
-  for( int i = 0; i <= numberOfInputs && weightStream >> weight; i++  )
-    {
-      weights.push_back(weight);
-    }
-}
-
-/**
- * Read in network attributes (input dimension, number of layers, and layer types + sizes)
- * from file.
- */
-
-void loadStats(std::ifstream& weightStream)
-{
-  int lSize;
-  std::string lType;
-
-  weightStream >> inputDimension;
-  std::cout << inputDimension << std::endl;
-  weightStream >> numberLayers;
-  std::cout << numberLayers << std::endl;
-
-  for (int i = 0; i < numberLayers && weightStream >> lSize; i++)
-  {
-    layerSize[i] = lSize;
-    weightStream >> lType;
-    std::cout << lType << std::endl;
-    layerType[i] = getLayerType(lType);
-  }
-}
-
 /**
  * main program reads in saved weights and runs samples through network.
  */
@@ -105,28 +65,21 @@ if( argc <= minimumParameters )
     printf("Could not create outputs file: %s\n", outputFile);
   }
 
-  std::vector<double> weights;
-
-  layerSize = new int[numberLayers];
-  layerType = new ActivationFunction*[numberLayers];
-
-  loadStats(weightStream);
+  if( !loadStats(weightStream, inputDimension, numberLayers, layerSize, layerType) )
+  {
+    printf("Weight file %s has no network attributes\n", weightFile);
+    exit(1);
+  }
 
   Network network(numberLayers, layerSize, layerType, inputDimension);
 
-  int layer, neuron;
-  double sensitivity;
-
   // Set up neuron weights and sensitivities one-by-one
-  while (weightStream >> layer) {
-  	weightStream >> neuron;
-  	loadNextNeuronWeights(weightStream, weights);
-    weightStream >> sensitivity;
-    network.setFixedSensitivity(layer, neuron, sensitivity);
-  	for (std::vector<double>::size_type i = 0; i < weights.size(); i++) {
-  		network.setWeight(layer, neuron, i, weights.at(i));
-  	}
+  if( !loadWeights(weightStream, network) )
+  {
+    printf("Weight file %s has missing or misplaced weights\n", weightFile);
+    exit(1);
   }
+
   network.showWeights("set");
 
 int inputDimension2;         // dimension of input